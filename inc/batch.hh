@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef BATCH_HH
+#define BATCH_HH
+
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+/**
+ * @brief Outcome of processing one file of a batch
+ */
+struct BatchResult {
+    /**
+     * @brief Path to processed file
+     */
+    std::string file;
+    /**
+     * @brief Size of the file in bytes
+     */
+    std::size_t bytes = 0;
+    /**
+     * @brief Number of pixels of the image, 0 if it could not be loaded
+     */
+    long long pixels = 0;
+    /**
+     * @brief Time of processing in seconds, including loading and saving
+     */
+    double seconds = 0;
+    /**
+     * @brief Whether the file was processed successfully
+     */
+    bool success = false;
+};
+
+
+/**
+ * @brief Processes many files in parallel, every thread has its own queue of files and steals from other queues when its queue is empty
+ */
+class Batch {
+    private:
+        /**
+         * @brief Files to process, sorted from the largest one
+         */
+        std::vector<std::string> files;
+        /**
+         * @brief Outcome of every file, in the same order as files
+         */
+        std::vector<BatchResult> results;
+        /**
+         * @brief Queue of indices of files for every thread
+         */
+        std::vector<std::deque<int>> queues;
+        /**
+         * @brief Protects queue with the same index
+         */
+        std::vector<std::mutex> locks;
+        /**
+         * @brief Time of processing of the whole batch in seconds
+         */
+        double seconds = 0;
+
+        /**
+         * @brief Take next file of a thread - the largest one from its own queue or the smallest one from queue of another thread
+         * @param thread index of thread
+         * @param index index of taken file
+         * @return Boolean value - whether there was any file left or not
+         */
+        bool take(int thread, int &index);
+        /**
+         * @brief Main loop of a thread, processes files until all queues are empty
+         * @param thread index of thread
+         * @param process function that processes one file
+         */
+        void work(int thread, const std::function<bool(const std::string &, BatchResult &)> &process);
+
+    public:
+        /**
+         * @brief Constructor
+         * @param files paths to files that will be processed
+         */
+        explicit Batch(std::vector<std::string> files);
+        /**
+         * @brief Find files given by a directory(every PGM and PPM file in it) or a glob pattern
+         * @param source path to a directory or a pattern, e.g. "pic/k*.ppm"
+         * @param found paths to found files are appended to it
+         * @return Boolean value - whether any file was found or not
+         */
+        static bool collect(const std::string &source, std::vector<std::string> &found);
+        /**
+         * @brief Process all files and wait until all of them are finished
+         * @param threads number of files processed at the same time
+         * @param process function called with path to a file, it sets pixels of the result and returns whether it succeeded
+         */
+        void run(int threads, const std::function<bool(const std::string &, BatchResult &)> &process);
+        /**
+         * @brief Print time and throughput of every file and of the whole batch
+         * @param out stream to which the report is written
+         */
+        void report(std::ostream &out) const;
+        /**
+         * @brief Get number of files that could not be processed
+         * @return Number of failed files
+         */
+        int failures() const;
+};
+
+
+#endif
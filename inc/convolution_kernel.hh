@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef CONVOLUTION_KERNEL_HH
+#define CONVOLUTION_KERNEL_HH
+
+
+#include <cstddef>
+#include <vector>
+
+
+/**
+ * @brief Square matrix of weights of a convolution, every pixel becomes the weighted sum of pixels around it
+ */
+class ConvolutionKernel {
+    private:
+        /**
+         * @brief Width and height of the matrix, odd number
+         */
+        int size;
+        /**
+         * @brief Weights row by row, weight (i, j) is applied to the pixel i - radius rows below and j - radius columns to the right
+         */
+        std::vector<double> weights;
+
+    public:
+        /**
+         * @brief Greatest supported radius of a kernel
+         */
+        static constexpr int MAX_RADIUS = 60;
+
+        /**
+         * @brief Constructor of a kernel with given weights
+         * @param size width and height of the matrix, odd number in range [1; 2 * MAX_RADIUS + 1]
+         * @param weights size * size weights row by row
+         */
+        ConvolutionKernel(int size, std::vector<double> weights);
+        /**
+         * @brief Gaussian blur, weights are cut at three standard deviations from the centre
+         * @param sigma standard deviation in range (0; MAX_RADIUS / 3]
+         * @return Kernel of gaussian blur
+         */
+        static ConvolutionKernel gaussian(double sigma);
+        /**
+         * @brief Sharpening that adds difference between a pixel and its four neighbours
+         * @param amount weight of the difference, greater than 0
+         * @return 3x3 kernel of sharpening
+         */
+        static ConvolutionKernel sharpen(double amount);
+        /**
+         * @brief Kernel of given weights, they are divided by their sum unless they sum up to 0(e.g. edge detection)
+         * @param weights weights row by row, their number is a square of an odd number
+         * @return Kernel of normalised weights
+         */
+        static ConvolutionKernel custom(std::vector<double> weights);
+        /**
+         * @brief Check whether number of weights is a square of an odd number of supported size
+         * @param count number of weights
+         * @return Boolean value - whether the weights make a kernel or not
+         */
+        static bool isSquare(std::size_t count);
+        /**
+         * @brief Get width and height of the matrix
+         * @return Size of the kernel
+         */
+        int getSize() const;
+        /**
+         * @brief Get number of pixels on every side of the centre that are used
+         * @return Radius of the kernel
+         */
+        int getRadius() const;
+        /**
+         * @brief Get weights of one row of the matrix
+         * @param i index of row
+         * @return Weights of row i
+         */
+        std::vector<float> row(int i) const;
+        /**
+         * @brief Check whether the kernel is an outer product of a column and a row, then it is applied as two 1-D passes
+         * @param vertical weights of the column
+         * @param horizontal weights of the row
+         * @return Boolean value - whether the kernel is separable or not
+         */
+        bool separate(std::vector<float> &vertical, std::vector<float> &horizontal) const;
+};
+
+
+#endif
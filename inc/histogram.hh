@@ -0,0 +1,124 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef HISTOGRAM_HH
+#define HISTOGRAM_HH
+
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+class Lut;
+
+
+/**
+ * @brief Histogram of one colour plane - number of samples of every value from 0 to depth
+ */
+class Histogram {
+    private:
+        /**
+         * @brief Maximal value of a sample
+         */
+        int depth;
+        /**
+         * @brief Number of samples of every value
+         */
+        std::vector<std::uint64_t> counts;
+        /**
+         * @brief Number of all counted samples
+         */
+        std::uint64_t total = 0;
+
+    public:
+        /**
+         * @brief Constructor of an empty histogram
+         * @param depth maximal value of a sample
+         */
+        explicit Histogram(int depth);
+        /**
+         * @brief Count samples of a span, samples must not be greater than depth
+         * @param span pointer to the first sample
+         * @param size number of samples
+         */
+        template <typename T>
+        void count(const T *span, std::size_t size);
+        /**
+         * @brief Add counts of another histogram of the same depth, e.g. histogram of another band of rows
+         * @param other histogram that is added
+         */
+        void merge(const Histogram &other);
+        /**
+         * @brief Histogram of the plane after every sample is replaced with its value in a lookup table
+         * @param lut lookup table of the same depth
+         * @return Histogram of mapped samples
+         */
+        Histogram map(const Lut &lut) const;
+        /**
+         * @brief Get number of samples of a value
+         * @param value sample in range [0; depth]
+         * @return Number of samples
+         */
+        std::uint64_t operator[](int value) const { return this->counts[value]; }
+        /**
+         * @brief Get maximal value of a sample
+         * @return Depth of the histogram
+         */
+        int getDepth() const { return this->depth; }
+        /**
+         * @brief Get number of all counted samples
+         * @return Number of samples
+         */
+        std::uint64_t getTotal() const { return this->total; }
+        /**
+         * @brief Find the lowest value present in the histogram
+         * @return Lowest value, depth for empty histogram
+         */
+        int min() const;
+        /**
+         * @brief Find the highest value present in the histogram
+         * @return Highest value, 0 for empty histogram
+         */
+        int max() const;
+        /**
+         * @brief Find the lowest value that is not smaller than given fraction of samples
+         * @param fraction fraction of samples in range [0; 1], 0 gives the lowest and 1 the highest value present
+         * @return Value of the percentile, depth for empty histogram
+         */
+        int percentile(double fraction) const;
+};
+
+
+template <typename T>
+void Histogram::count(const T *span, std::size_t size) {
+    std::uint64_t *counts = this->counts.data();
+
+    for(std::size_t k = 0; k < size; ++k) {
+        ++counts[span[k]];
+    }
+    this->total += size;
+}
+
+
+#endif
@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef HISTORY_HH
+#define HISTORY_HH
+
+
+#include "pipeline.hh"
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+
+/**
+ * @brief Undo and redo history of processing steps. Snapshots share planes with the image copy-on-write,
+ *        so taking a snapshot copies no pixels and stepping back over a filter of one colour costs at most one plane
+ */
+class History {
+    private:
+        /**
+         * @brief Pipeline of the image whose states are recorded
+         */
+        Pipeline &pipeline;
+        /**
+         * @brief Maximal number of steps that can be undone
+         */
+        std::size_t limit;
+        /**
+         * @brief States before steps that can be undone, the latest one is at the back
+         */
+        std::deque<Pipeline::Snapshot> past;
+        /**
+         * @brief States after steps that can be redone, the nearest one is at the back
+         */
+        std::vector<Pipeline::Snapshot> future;
+
+    public:
+        /**
+         * @brief Constructor of an empty history
+         * @param pipeline pipeline of the image whose states are recorded
+         * @param limit maximal number of steps that can be undone, older states are forgotten
+         */
+        explicit History(Pipeline &pipeline, std::size_t limit = 32);
+        /**
+         * @brief Remember current state before a step changes it, steps that were undone can not be redone anymore
+         */
+        void checkpoint();
+        /**
+         * @brief Return to the state before the last step
+         * @return Boolean value - whether there was any step to undo or not
+         */
+        bool undo();
+        /**
+         * @brief Repeat the last undone step
+         * @return Boolean value - whether there was any step to redo or not
+         */
+        bool redo();
+        /**
+         * @brief Forget all states, e.g. when new image is loaded
+         */
+        void clear();
+};
+
+
+#endif
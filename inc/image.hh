@@ -25,10 +25,21 @@ SOFTWARE.
 #define IMAGE_HH
 
 
+#include "lut.hh"
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <string>
 
 
+class ConvolutionKernel;
+class Histogram;
+class NetpbmReader;
+class NetpbmWriter;
+class SummedArea;
+
+
 /**
  * @brief Class containing data of image and processing methods that can be used on images
  */
@@ -37,68 +48,325 @@ class Image {
         /**
          * @brief Width of image(horizontally)
          */
-        int width;
+        int width = 0;
         /**
          * @brief Height of image(vertically)
          */
-        int height;
+        int height = 0;
         /**
          * @brief Precision of each pixel, grey scale
          */    
-        int depth;
+        int depth = 0;
         /**
          * @brief Image type(PGM or PPM), 1 stands for PGM, 3 stands for PPM
          */          
-        int img_type;
+        int img_type = 0;
         /**
-         * @brief Which colour will be processed - 0, 1, 2 stands for red(or grey for PGM), green, blue
+         * @brief Which colour will be processed - 0, 1, 2 stands for red(or grey for PGM), green, blue, ALL_COLOURS for all of them
          */       
-        int colour;
+        int colour = 0;
+        /**
+         * @brief Size of one sample in bytes, 1 for depth up to 255, 2 for depth up to 65535
+         */
+        int sample_size = 1;
+        /**
+         * @brief Number of samples between the starts of two consecutive rows, padded so that every row is cache line aligned
+         */
+        int stride = 0;
+        /**
+         * @brief Aligned memory of every colour plane - sample (c, i, j) is sample number i * stride + j of planes[c].
+         *        Planes are shared by copies of the image(e.g. snapshots of undo history) and copied only when they are changed
+         */
+        std::shared_ptr<unsigned char> planes[3];
+        /**
+         * @brief Cached histogram of every plane, nullptr until it is needed and after the plane is changed
+         */
+        mutable std::shared_ptr<const Histogram> histograms[3];
+        /**
+         * @brief Cached summed-area table of every plane, it is kept in a slot shared by copies of the image that share the plane,
+         *        so a table built after a snapshot of undo history was taken is still there when the snapshot is restored
+         */
+        mutable std::shared_ptr<std::shared_ptr<const SummedArea>> areas[3];
+
+        /**
+         * @brief Allocate aligned memory for one plane of current width, height and sample size, memory of a released plane of the same size is reused
+         * @return Allocated plane, rows padding is zero initialised, samples of a reused plane are left as they were
+         */
+        std::shared_ptr<unsigned char> allocatePlane() const;
         /**
-         * @brief Pointer to dynamically allocated memory for pixels - pixels[colour][height][width]
-         */         
-        int ***pixels = nullptr; 
+         * @brief Drop cached histogram and summed-area table of a plane before it is changed or replaced, copies of the image that still have the old plane keep its table
+         * @param c index of colour plane
+         */
+        void forget(int c);
+        /**
+         * @brief Make sure that a plane is not shared with any other image before it is changed in place, its cached histogram is dropped
+         * @param c index of colour plane
+         */
+        void detach(int c);
+        /**
+         * @brief Detach every plane of processed colours
+         */
+        void detachColours();
+        /**
+         * @brief Get the first processed colour
+         * @return Index of the first processed plane
+         */
+        int firstColour() const;
+        /**
+         * @brief Get the colour after the last processed one
+         * @return Index of the plane after the last processed plane
+         */
+        int lastColour() const;
+        /**
+         * @brief Replace memory of a plane, e.g. with a processed copy, its cached histogram and summed-area table are dropped
+         * @param c index of colour plane
+         * @param plane new memory of the plane, nullptr for unused plane
+         */
+        void replace(int c, std::shared_ptr<unsigned char> plane);
+        /**
+         * @brief Count histograms of a range of planes that have no cached histogram, in one pass over the image
+         * @param first first plane of the range
+         * @param last plane after the last plane of the range
+         */
+        void countHistograms(int first, int last) const;
+        /**
+         * @brief Get pointer to the first sample of a plane
+         * @param c index of colour plane
+         * @return Pointer to the first sample of plane c
+         */
+        template <typename T>
+        T *plane(int c) const;
+        /**
+         * @brief Get pointer to the first sample of a row
+         * @param c index of colour plane
+         * @param i index of row
+         * @return Pointer to the first sample of row i in plane c
+         */
+        template <typename T>
+        T *row(int c, int i) const;
+        /**
+         * @brief Number of samples in one plane, including rows padding
+         * @return Size of a plane in samples
+         */
+        std::size_t planeSize() const;
+        /**
+         * @brief Check whether blurs should use summed-area tables - every processed plane has its table already or it is kept by a snapshot,
+         *        so it may be blurred again. Building a table costs more than one blur with running sums, blur from a built table costs less
+         * @return Boolean value - whether summed-area tables are used or not
+         */
+        bool keepsSummedArea() const;
+        /**
+         * @brief Box blurring of processed colours computed from their summed-area tables, so its cost does not depend on radius and the tables are reused by next blurs of the same planes.
+         *        Window of every pixel is a row, a column or a cross of both, the same as windows of horizontal, vertical and full blurring
+         * @param horizontal radius of the window along the row, -1 for none
+         * @param vertical radius of the window along the column, -1 for none
+         * @param post lookup table applied to every row of every processed colour right after it is blurred, nullptr for none
+         */
+        void summedAreaBlurring(int horizontal, int vertical, const Lut *post);
+        /**
+         * @brief Make a smaller copy of the image, every pixel is the mean of a block of pixels
+         * @param factor width and height of a block, blocks at the right and bottom edge may be smaller
+         * @return Reduced image of the same type, depth and selected colour
+         */
+        Image shrink(int factor) const;
+        /**
+         * @brief Call given function with a value of sample type of the image(uint8_t or uint16_t), so that every kernel is compiled for both sample sizes
+         * @param kernel generic function that deduces sample type from its argument
+         */
+        template <typename Kernel>
+        void dispatch(Kernel kernel) const;
     
     public:
+        /**
+         * @brief Selection of colour that makes filters process all colours of the image in one sweep
+         */
+        static constexpr int ALL_COLOURS = 3;
+        /**
+         * @brief The greatest radius of median filter
+         */
+        static constexpr int MAX_MEDIAN_RADIUS = 127;
+        /**
+         * @brief Weights of colours in conversion to grey - mean of colours, luma of ITU-R BT.601 or luma of ITU-R BT.709
+         */
+        enum GreyWeights {
+            AVERAGE,
+            BT601,
+            BT709
+        };
+        /**
+         * @brief Operator of gradient - differences of right and lower neighbours, Sobel or Scharr
+         */
+        enum GradientOperator {
+            DIFFERENCES,
+            SOBEL,
+            SCHARR
+        };
+        /**
+         * @brief Magnitude of gradient - sum of absolute values of its components or euclidean length
+         */
+        enum GradientNorm {
+            L1,
+            L2
+        };
+
         /**
          * @brief Nonparametric constructor
          */  
         Image() {};
         /**
-         * @brief Copy constructor
+         * @brief Copy constructor, planes are shared by both images until one of them changes a plane
          * @param img image object
          */ 
-        Image(const Image & img);
+        Image(const Image & img) = default;
+        /**
+         * @brief Copy assignment, planes are shared by both images until one of them changes a plane
+         * @param img image object
+         * @return Reference to this image
+         */
+        Image &operator=(const Image &img) = default;
+        /**
+         * @brief Move constructor, planes are taken over without touching their samples or counts of their users, moved image is left empty
+         * @param img image object
+         */
+        Image(Image &&img) noexcept;
         /**
-         * @brief Destructor that deletes pointer with allocated memory for pixels
+         * @brief Move assignment, planes of this image are released and planes of moved image are taken over, moved image is left empty
+         * @param img image object
+         * @return Reference to this image
+         */
+        Image &operator=(Image &&img) noexcept;
+        /**
+         * @brief Destructor, memory of a plane is freed when no image uses it
          */
-        ~Image();
+        ~Image() = default;
         /**
-         * @brief Load image from a text file
+         * @brief Load image from a text(P2, P3) or binary(P5, P6) file
          * @param img_title file name from which image is loaded
          * @return Boolean value - whether the operation was successful or not
          */
         bool load(std::string img_title); 
         /**
-         * @brief Save current state of image to a text file
+         * @brief Load image from a file given by its path
+         * @param file_name path to the file
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool loadFile(std::string file_name);
+        /**
+         * @brief Load image from a file given by its path as grey image, colour image is converted to grey while it is decoded
+         * @param file_name path to the file
+         * @param weights weights of colours
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool loadGreyFile(std::string file_name, GreyWeights weights = AVERAGE);
+        /**
+         * @brief Allocate image of given size, all samples are set to 0 and red(or grey) colour is selected
+         * @param img_type 1 for PGM, 3 for PPM
+         * @param width number of pixels in a row
+         * @param height number of rows
+         * @param depth maximal value of a sample
+         */
+        void create(int img_type, int width, int height, int depth);
+        /**
+         * @brief Read next rows of an opened file into rows of the image
+         * @param source opened file of the same type, width and depth
+         * @param first row of the image to which the first read row is stored
+         * @param rows number of rows to read
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool readRows(NetpbmReader &source, int first, int rows);
+        /**
+         * @brief Write rows of the image as next rows of an opened file
+         * @param file opened file of the same type, width and depth
+         * @param first first row to write
+         * @param rows number of rows to write
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool writeRows(NetpbmWriter &file, int first, int rows) const;
+        /**
+         * @brief Copy rows of all planes from an image of the same type, width and depth, it may be this image
+         * @param source image from which rows are copied
+         * @param from first row copied from source
+         * @param to row of this image to which the first row is copied
+         * @param rows number of rows to copy
+         */
+        void copyRows(const Image &source, int from, int to, int rows);
+        /**
+         * @brief Save current state of image to a file
          * @param img_title file name to which image is saved
+         * @param binary whether image is saved as binary(P5, P6) or text(P2, P3) file
          * @return Boolean value - whether the operation was successful or not 
          */   
-        bool save(std::string img_title);  
+        bool save(std::string img_title, bool binary = true);  
         /**
-         * @brief Display current state of image on screen
+         * @brief Save current state of image to a file given by its path, no extension is added
+         * @param file_name path to the file
+         * @param binary whether image is saved as binary(P5, P6) or text(P2, P3) file
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool saveFile(std::string file_name, bool binary = true);
+        /**
+         * @brief Display current state of image on screen, binary image is sent straight to the standard input of the viewer through a pipe.
+         *        Image bigger than the screen is reduced before it is sent
+         * @return Boolean value - whether the operation was successful or not
          */  
-        void display();
+        bool display() const;
         /**
          * @brief Ask user to select new colour that will be processed
          * @return Boolean value - whether the operation was successful or not
          */                   
         bool selectColour();
+        /**
+         * @brief Get colour that is processed
+         * @return 0, 1, 2 stands for red(or grey for PGM), green, blue, ALL_COLOURS for all of them
+         */
+        int getColour() const;
+        /**
+         * @brief Set colour that will be processed without asking user
+         * @param c 0, 1, 2 stands for red(or grey for PGM), green, blue, ALL_COLOURS for all of them
+         */
+        void setColour(int c);
+        /**
+         * @brief Get width of image
+         * @return Number of pixels in a row
+         */
+        int getWidth() const;
+        /**
+         * @brief Get height of image
+         * @return Number of rows
+         */
+        int getHeight() const;
+        /**
+         * @brief Get maximal value of a sample
+         * @return Depth of image
+         */
+        int getDepth() const;
+        /**
+         * @brief Get image type
+         * @return 1 for PGM, 3 for PPM
+         */
+        int getType() const;
+        /**
+         * @brief Get histogram of a colour plane, it is counted when it is needed for the first time and cached until the plane changes
+         * @param c 0, 1, 2 stands for red(or grey for PGM), green, blue
+         * @return Histogram of the plane
+         */
+        const Histogram &histogram(int c) const;
+        /**
+         * @brief Get summed-area table of a colour plane, it is built when it is needed for the first time and cached until the plane changes
+         * @param c 0, 1, 2 stands for red(or grey for PGM), green, blue
+         * @return Summed-area table of the plane
+         */
+        const SummedArea &summedArea(int c) const;
+        /**
+         * @brief Stop keeping summed-area tables of all planes, copies of the image that share a table still keep it
+         */
+        void releaseSummedAreas();
         /**
          * @brief Convert colorful image to grey image(PPM to PGM convertion)
+         * @param weights weights of colours
          * @return Boolean value - whether the operation was successful or not
          */
-        bool conversion2grey(); 
+        bool conversion2grey(GreyWeights weights = AVERAGE); 
         /**
          * @brief Add negative filter to an image
          */           
@@ -129,29 +397,92 @@ class Image {
          */ 
         void levelAdjustment(double level);
         /**
-         * @brief Add contouring filter to an image
+         * @brief Replace every sample of processed colours with its value in lookup table
+         * @param lut lookup table, its depth must be the same as depth of the image
+         */
+        void transform(const Lut &lut);
+        /**
+         * @brief Replace samples of every plane that has a table with their values in it, all planes are processed in one sweep
+         * @param tables lookup table of every colour, nullptr leaves a colour unchanged
+         */
+        void transform(const ColourTables &tables);
+        /**
+         * @brief Add contouring filter to an image - magnitude of gradient of every pixel, divided by the sum of weights on one side of the operator,
+         *        pixels outside the image are the nearest pixels of the image
+         * @param op operator of gradient
+         * @param norm magnitude of gradient
+         * @param post lookup table applied to every row of every processed colour right after it is processed, nullptr for none
          */ 
-        void contouring();
+        void gradient(GradientOperator op = DIFFERENCES, GradientNorm norm = L1, const Lut *post = nullptr);
         /**
          * @brief Add horizontal blurring filter to an image
          * @param radius radius of horizontal blurring
+         * @param post lookup table applied to every row of every processed colour right after it is blurred, nullptr for none
          */ 
-        void horizontalBlurring(int radius);
+        void horizontalBlurring(int radius, const Lut *post = nullptr);
         /**
          * @brief Add nvertical blurring filter to an image
          * @param radius radius of vertical blurring
+         * @param post lookup table applied to every row of every processed colour right after it is blurred, nullptr for none
          */ 
-        void verticalBlurring(int radius);
+        void verticalBlurring(int radius, const Lut *post = nullptr);
         /**
          * @brief Add both horizontal and vertical blurring to an image
          * @param radius radius of full blurring
+         * @param post lookup table applied to every row of every processed colour right after it is blurred, nullptr for none
          */ 
-        void fullBlurring(int radius);
+        void fullBlurring(int radius, const Lut *post = nullptr);
+        /**
+         * @brief Add median filter to an image - every pixel becomes the median of the square window around it,
+         *        pixels outside the image are the nearest pixels of the image
+         * @param radius radius of the window in range [1; MAX_MEDIAN_RADIUS], greater radius is reduced
+         * @param post lookup table applied to every row of every processed colour right after it is filtered, nullptr for none
+         */
+        void medianFiltering(int radius, const Lut *post = nullptr);
+        /**
+         * @brief Add convolution with a kernel to an image, separable kernels are applied as a horizontal and a vertical pass,
+         *        pixels outside the image are the nearest pixels of the image
+         * @param kernel weights of the convolution
+         * @param post lookup table applied to every row of every processed colour right after it is convolved, nullptr for none
+         */
+        void convolution(const ConvolutionKernel &kernel, const Lut *post = nullptr);
         /**
          * @brief Add histogram stretching filter to an image
          */ 
         void histogramStretching();
+        /**
+         * @brief Add histogram equalization filter to an image
+         */
+        void histogramEqualization();
+        /**
+         * @brief Add histogram stretching filter that ignores given fraction of the darkest and the brightest samples
+         * @param clip fraction of samples in range[0; 0.5) that are clipped at each end of the histogram
+         */
+        void percentileStretching(double clip);
 };
 
 
+template <typename T>
+T *Image::plane(int c) const {
+    return reinterpret_cast<T *>(this->planes[c].get());
+}
+
+
+template <typename T>
+T *Image::row(int c, int i) const {
+    return this->plane<T>(c) + std::size_t(i) * this->stride;
+}
+
+
+template <typename Kernel>
+void Image::dispatch(Kernel kernel) const {
+    if(this->sample_size == 1) {
+        kernel(std::uint8_t());
+    }
+    else {
+        kernel(std::uint16_t());
+    }
+}
+
+
 #endif
@@ -0,0 +1,133 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef LUT_HH
+#define LUT_HH
+
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+class Histogram;
+
+
+/**
+ * @brief Lookup table of value to value mapping of samples, it has one entry for every value from 0 to depth
+ */
+class Lut {
+    private:
+        /**
+         * @brief Maximal value of a sample
+         */
+        int depth;
+        /**
+         * @brief New value of every sample, every entry is in range [0; depth]
+         */
+        std::vector<std::uint16_t> table;
+
+    public:
+        /**
+         * @brief Constructor of identity mapping
+         * @param depth maximal value of a sample
+         */
+        explicit Lut(int depth);
+        /**
+         * @brief Table of negative filter
+         * @param depth maximal value of a sample
+         * @return Lookup table
+         */
+        static Lut negative(int depth);
+        /**
+         * @brief Table of thresholding, half-thresholding of black and half-thresholding of white
+         * @param depth maximal value of a sample
+         * @param limit samples not greater than limit are below threshold
+         * @param below new value of samples below threshold, -1 keeps them unchanged
+         * @param above new value of samples above threshold, -1 keeps them unchanged
+         * @return Lookup table
+         */
+        static Lut threshold(int depth, int limit, int below, int above);
+        /**
+         * @brief Table of gamma correction
+         * @param depth maximal value of a sample
+         * @param gamma value of gamma parameter
+         * @return Lookup table
+         */
+        static Lut gamma(int depth, double gamma);
+        /**
+         * @brief Table of level adjustment
+         * @param depth maximal value of a sample
+         * @param level level value in range(0; 0.5)
+         * @return Lookup table
+         */
+        static Lut level(int depth, double level);
+        /**
+         * @brief Table of histogram stretching
+         * @param depth maximal value of a sample
+         * @param min lowest value present in the histogram
+         * @param max highest value present in the histogram
+         * @return Lookup table
+         */
+        static Lut stretching(int depth, int min, int max);
+        /**
+         * @brief Table of histogram equalization, values are spread so that their cumulative distribution becomes linear
+         * @param histogram histogram of processed plane
+         * @return Lookup table of the same depth as the histogram
+         */
+        static Lut equalization(const Histogram &histogram);
+        /**
+         * @brief Compose two mappings into one table
+         * @param next mapping applied after this one
+         * @return Lookup table equal to applying this table and then the next one
+         */
+        Lut then(const Lut &next) const;
+        /**
+         * @brief Get new value of a sample
+         * @param value sample in range [0; depth]
+         * @return New value of the sample
+         */
+        int operator[](int value) const { return this->table[value]; }
+        /**
+         * @brief Get maximal value of a sample
+         * @return Depth of the table
+         */
+        int getDepth() const { return this->depth; }
+        /**
+         * @brief Replace every sample with its new value, samples must not be greater than depth
+         * @param span pointer to the first sample
+         * @param size number of samples
+         */
+        void apply(std::uint8_t *span, std::size_t size) const;
+        void apply(std::uint16_t *span, std::size_t size) const;
+};
+
+
+/**
+ * @brief Lookup tables of every colour plane, indexed by colour, nullptr leaves a plane unchanged
+ */
+using ColourTables = std::array<const Lut *, 3>;
+
+
+#endif
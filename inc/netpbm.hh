@@ -0,0 +1,257 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef NETPBM_HH
+#define NETPBM_HH
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * @brief Reader of PGM and PPM files(P2, P3, P5, P6), file is memory mapped and decoded straight from the mapping
+ */
+class NetpbmReader {
+    private:
+        /**
+         * @brief File descriptor of opened file, -1 when nothing is opened
+         */
+        int fd = -1;
+        /**
+         * @brief Pointer to memory mapped content of the file
+         */
+        const char *data = nullptr;
+        /**
+         * @brief Size of the file in bytes
+         */
+        std::size_t size = 0;
+        /**
+         * @brief Offset of the first byte that has not been decoded yet
+         */
+        std::size_t position = 0;
+        /**
+         * @brief Width of image(horizontally)
+         */
+        int width = 0;
+        /**
+         * @brief Height of image(vertically)
+         */
+        int height = 0;
+        /**
+         * @brief Maximal value of a sample
+         */
+        int depth = 0;
+        /**
+         * @brief Image type(PGM or PPM), 1 stands for PGM, 3 stands for PPM
+         */
+        int img_type = 0;
+        /**
+         * @brief Whether samples are stored as raw bytes(P5, P6) or as text(P2, P3)
+         */
+        bool binary = false;
+
+        /**
+         * @brief Read next decimal number from the file, whitespaces and comments before it are skipped
+         * @param value read number
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool readNumber(int &value);
+        /**
+         * @brief Decode next rows of text samples, numbers are parsed in bulk with std::from_chars
+         * @param rows number of rows to read
+         * @param planes pointers to the first sample of the rows in every plane
+         * @param stride number of samples between the starts of two consecutive rows in planes
+         * @return Boolean value - whether the operation was successful or not
+         */
+        template <typename T>
+        bool readTextRows(int rows, T *const *planes, std::ptrdiff_t stride);
+
+    public:
+        /**
+         * @brief Nonparametric constructor
+         */
+        NetpbmReader() {};
+        /**
+         * @brief Destructor that unmaps and closes the file
+         */
+        ~NetpbmReader();
+        /**
+         * @brief Open and map a file, then read its header
+         * @param file_name path to the file
+         * @param populate whether the whole file is read into memory at once, files that are streamed in bands are read when they are decoded
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool open(std::string file_name, bool populate = true);
+        /**
+         * @brief Drop pages of the file that have already been decoded from memory
+         */
+        void release();
+        /**
+         * @brief Unmap and close the file
+         */
+        void close();
+        /**
+         * @brief Read next rows of the image into separate planes
+         * @param rows number of rows to read
+         * @param planes pointers to the first sample of the rows in every plane(one plane for PGM, three for PPM)
+         * @param stride number of samples between the starts of two consecutive rows in planes
+         * @return Boolean value - whether the operation was successful or not
+         */
+        template <typename T>
+        bool readRows(int rows, T *const *planes, std::ptrdiff_t stride);
+
+        /**
+         * @brief Get width of image
+         * @return Width of image
+         */
+        int getWidth() const { return this->width; }
+        /**
+         * @brief Get height of image
+         * @return Height of image
+         */
+        int getHeight() const { return this->height; }
+        /**
+         * @brief Get maximal value of a sample
+         * @return Depth of image
+         */
+        int getDepth() const { return this->depth; }
+        /**
+         * @brief Get image type
+         * @return 1 for PGM, 3 for PPM
+         */
+        int getType() const { return this->img_type; }
+        /**
+         * @brief Check whether samples are stored as raw bytes
+         * @return Boolean value - whether the file is P5/P6 or not
+         */
+        bool isBinary() const { return this->binary; }
+};
+
+
+/**
+ * @brief Writer of PGM and PPM files, both binary(P5, P6) and text(P2, P3)
+ */
+class NetpbmWriter {
+    private:
+        /**
+         * @brief File descriptor of opened file, -1 when nothing is opened
+         */
+        int fd = -1;
+        /**
+         * @brief Width of image(horizontally)
+         */
+        int width = 0;
+        /**
+         * @brief Maximal value of a sample
+         */
+        int depth = 0;
+        /**
+         * @brief Image type(PGM or PPM), 1 stands for PGM, 3 stands for PPM
+         */
+        int img_type = 0;
+        /**
+         * @brief Whether samples are written as raw bytes(P5, P6) or as text(P2, P3)
+         */
+        bool binary = true;
+        /**
+         * @brief Buffer in which rows are interleaved(and formatted for text files) before they are written
+         */
+        std::vector<unsigned char> buffer;
+        /**
+         * @brief Every possible sample formatted as text followed by a space, one 8 byte entry per value
+         */
+        std::vector<char> texts;
+        /**
+         * @brief Length of every formatted sample, including the space
+         */
+        std::vector<unsigned char> lengths;
+
+        /**
+         * @brief Format next rows as text using table of samples formatted with std::to_chars, buffer is written in big chunks
+         * @param rows number of rows to write
+         * @param planes pointers to the first sample of the rows in every plane
+         * @param stride number of samples between the starts of two consecutive rows in planes
+         * @return Boolean value - whether the operation was successful or not
+         */
+        template <typename T>
+        bool writeTextRows(int rows, const T *const *planes, std::ptrdiff_t stride);
+
+        /**
+         * @brief Write beginning of the buffer to the file
+         * @param bytes number of bytes to write
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool flush(std::size_t bytes);
+
+    public:
+        /**
+         * @brief Nonparametric constructor
+         */
+        NetpbmWriter() {};
+        /**
+         * @brief Destructor that closes the file
+         */
+        ~NetpbmWriter();
+        /**
+         * @brief Create a file and write its header
+         * @param file_name path to the file
+         * @param img_type image type, 1 stands for PGM, 3 stands for PPM
+         * @param width width of image
+         * @param height height of image
+         * @param depth maximal value of a sample
+         * @param binary whether samples are written as raw bytes(P5, P6) or as text(P2, P3)
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool open(std::string file_name, int img_type, int width, int height, int depth, bool binary = true);
+        /**
+         * @brief Take over an opened descriptor(e.g. write end of a pipe) and write header to it, descriptor is closed with the writer
+         * @param fd opened file descriptor
+         * @param img_type image type, 1 stands for PGM, 3 stands for PPM
+         * @param width width of image
+         * @param height height of image
+         * @param depth maximal value of a sample
+         * @param binary whether samples are written as raw bytes(P5, P6) or as text(P2, P3)
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool attach(int fd, int img_type, int width, int height, int depth, bool binary = true);
+        /**
+         * @brief Close the file
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool close();
+        /**
+         * @brief Write next rows of the image, binary rows are interleaved in one buffer and written with one call
+         * @param rows number of rows to write
+         * @param planes pointers to the first sample of the rows in every plane(one plane for PGM, three for PPM)
+         * @param stride number of samples between the starts of two consecutive rows in planes
+         * @return Boolean value - whether the operation was successful or not
+         */
+        template <typename T>
+        bool writeRows(int rows, const T *const *planes, std::ptrdiff_t stride);
+};
+
+
+#endif
@@ -0,0 +1,272 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef PIPELINE_HH
+#define PIPELINE_HH
+
+
+#include "convolution_kernel.hh"
+#include "image.hh"
+#include "lut.hh"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+
+/**
+ * @brief Deferred list of filters recorded against an image. Filters are applied only when the pipeline is flushed,
+ *        consecutive value to value filters are fused into one lookup table for every colour and applied in one pass,
+ *        value to value filters that follow a blur, median, convolution or contouring are applied in the same sweep
+ */
+class Pipeline {
+    private:
+        /**
+         * @brief Kind of recorded filter
+         */
+        enum Kind {
+            NEGATIVE,
+            THRESHOLDING,
+            HALF_THRESHOLDING_BLACK,
+            HALF_THRESHOLDING_WHITE,
+            GAMMA_CORRECTION,
+            LEVEL_ADJUSTMENT,
+            GRADIENT,
+            HORIZONTAL_BLURRING,
+            VERTICAL_BLURRING,
+            FULL_BLURRING,
+            MEDIAN_FILTERING,
+            CONVOLUTION,
+            HISTOGRAM_STRETCHING,
+            HISTOGRAM_EQUALIZATION,
+            PERCENTILE_STRETCHING
+        };
+        /**
+         * @brief Recorded filter
+         */
+        struct Operation {
+            /**
+             * @brief Kind of filter
+             */
+            Kind kind;
+            /**
+             * @brief Colour that was selected when filter was recorded
+             */
+            int colour;
+            /**
+             * @brief Parameter of filter(threshold, gamma, level, radius, clip or operator of gradient), unused by filters without parameter
+             */
+            double parameter;
+            /**
+             * @brief Kernel of convolution, nullptr for other filters
+             */
+            std::shared_ptr<const ConvolutionKernel> kernel;
+            /**
+             * @brief Magnitude of gradient, its operator is the parameter, unused by other filters
+             */
+            Image::GradientNorm norm = Image::L1;
+        };
+        /**
+         * @brief Image that filters are applied to
+         */
+        Image &image;
+        /**
+         * @brief Filters that have not been applied yet
+         */
+        std::vector<Operation> pending;
+
+        /**
+         * @brief Record a filter for current colour of the image
+         * @param kind kind of filter
+         * @param parameter parameter of filter
+         * @param kernel kernel of convolution
+         */
+        void record(Kind kind, double parameter = 0, std::shared_ptr<const ConvolutionKernel> kernel = nullptr);
+        /**
+         * @brief Check whether filter is a value to value mapping
+         * @param kind kind of filter
+         * @return Boolean value - whether the filter can be expressed as a lookup table or not
+         */
+        static bool isPoint(Kind kind);
+        /**
+         * @brief Build lookup table of a value to value filter
+         * @param operation recorded filter
+         * @return Lookup table of the filter
+         */
+        Lut table(const Operation &operation) const;
+        /**
+         * @brief Compose lookup tables of consecutive value to value filters of the same colour
+         * @param first index of the first filter
+         * @param colour colour of filters
+         * @param lut composed lookup table
+         * @return Index of the first filter that is not composed
+         */
+        std::size_t fuse(std::size_t first, int colour, Lut &lut) const;
+        /**
+         * @brief Compose lookup tables of consecutive value to value filters of any colours, one table for every colour
+         * @param first index of the first filter
+         * @param luts composed lookup table of every colour, identity tables at the beginning
+         * @param tables pointers to tables of colours that are changed by the filters
+         * @return Index of the first filter that is not composed
+         */
+        std::size_t fuseColours(std::size_t first, std::vector<Lut> &luts, ColourTables &tables) const;
+        /**
+         * @brief Apply one filter directly to the image
+         * @param operation recorded filter
+         * @param post lookup table applied in the same sweep, nullptr for none
+         */
+        void apply(const Operation &operation, const Lut *post);
+
+    public:
+        /**
+         * @brief State of the image together with filters that have not been applied to it yet, planes of the image are shared, not copied
+         */
+        class Snapshot {
+            friend class Pipeline;
+
+            private:
+                /**
+                 * @brief Copy of the image that shares its planes
+                 */
+                Image image;
+                /**
+                 * @brief Filters that had not been applied yet
+                 */
+                std::vector<Operation> pending;
+
+            public:
+                /**
+                 * @brief Stop keeping summed-area tables of the image, e.g. when the snapshot is not the newest one anymore
+                 */
+                void releaseSummedAreas();
+        };
+
+        /**
+         * @brief Constructor of an empty pipeline
+         * @param img image that filters are applied to
+         */
+        explicit Pipeline(Image &img) : image(img) {};
+        /**
+         * @brief Apply all recorded filters to the image
+         */
+        void flush();
+        /**
+         * @brief Drop all recorded filters, e.g. when new image is loaded
+         */
+        void clear();
+        /**
+         * @brief Take a snapshot of current state, it costs no copy of pixels
+         * @return Snapshot of the image and recorded filters
+         */
+        Snapshot snapshot() const;
+        /**
+         * @brief Return to a snapshot, planes changed since it was taken are replaced by the ones it holds
+         * @param state snapshot taken by this pipeline
+         */
+        void restore(const Snapshot &state);
+        /**
+         * @brief Return to a snapshot that is not needed anymore, its planes are taken over instead of shared
+         * @param state snapshot taken by this pipeline
+         */
+        void restore(Snapshot &&state);
+        /**
+         * @brief Check whether there are filters that have not been applied yet
+         * @return Boolean value - whether the pipeline is empty or not
+         */
+        bool empty() const;
+        /**
+         * @brief Record negative filter
+         */
+        void negative();
+        /**
+         * @brief Record thresholding filter
+         * @param threshold threshold value in range(0; 1) for thresholding
+         */
+        void thresholding(double threshold);
+        /**
+         * @brief Record half-thresholding of black filter
+         * @param threshold threshold value in range(0; 1) for half-thresholding of black
+         */
+        void halfThresholdingBlack(double threshold);
+        /**
+         * @brief Record half-thresholding of white filter
+         * @param threshold threshold value in range(0; 1) for half-thresholding of white
+         */
+        void halfThresholdingWhite(double threshold);
+        /**
+         * @brief Record gamma correction
+         * @param gamma value of gamma parameter
+         */
+        void gammaCorrection(double gamma);
+        /**
+         * @brief Record level adjustment filter
+         * @param level level value in range(0; 0.5) for level adjustment
+         */
+        void levelAdjustment(double level);
+        /**
+         * @brief Record contouring filter
+         * @param op operator of gradient
+         * @param norm magnitude of gradient
+         */
+        void gradient(Image::GradientOperator op = Image::DIFFERENCES, Image::GradientNorm norm = Image::L1);
+        /**
+         * @brief Record horizontal blurring filter
+         * @param radius radius of horizontal blurring
+         */
+        void horizontalBlurring(int radius);
+        /**
+         * @brief Record vertical blurring filter
+         * @param radius radius of vertical blurring
+         */
+        void verticalBlurring(int radius);
+        /**
+         * @brief Record both horizontal and vertical blurring
+         * @param radius radius of full blurring
+         */
+        void fullBlurring(int radius);
+        /**
+         * @brief Record median filter
+         * @param radius radius of the window of median filter
+         */
+        void medianFiltering(int radius);
+        /**
+         * @brief Record convolution with a kernel, e.g. gaussian blur or sharpening
+         * @param kernel weights of the convolution, they are copied
+         */
+        void convolution(const ConvolutionKernel &kernel);
+        /**
+         * @brief Record histogram stretching filter, it depends on data, so filters before it are applied first when flushed
+         */
+        void histogramStretching();
+        /**
+         * @brief Record histogram equalization filter, it depends on data, so filters before it are applied first when flushed
+         */
+        void histogramEqualization();
+        /**
+         * @brief Record histogram stretching filter that ignores the darkest and the brightest samples
+         * @param clip fraction of samples in range[0; 0.5) that are clipped at each end of the histogram
+         */
+        void percentileStretching(double clip);
+};
+
+
+#endif
@@ -0,0 +1,117 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef PLANE_POOL_HH
+#define PLANE_POOL_HH
+
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+/**
+ * @brief Pool of aligned memory blocks of colour planes. Memory of a plane that is no longer used by any image is kept
+ *        in the pool and given to the next plane of the same size, so filters that replace planes allocate nothing when they are repeated
+ */
+class PlanePool {
+    private:
+        /**
+         * @brief Block of memory that is not used by any plane
+         */
+        struct Block {
+            /**
+             * @brief Aligned memory of the block
+             */
+            unsigned char *memory;
+            /**
+             * @brief Size of the block in bytes
+             */
+            std::size_t bytes;
+        };
+        /**
+         * @brief Protects free blocks, planes are allocated and freed by many threads in batch mode
+         */
+        std::mutex mutex;
+        /**
+         * @brief Free blocks, the most recently freed one is the last
+         */
+        std::vector<Block> blocks;
+        /**
+         * @brief Maximal number of free blocks that are kept
+         */
+        std::size_t limit;
+
+        /**
+         * @brief Return memory of a plane to the pool, the oldest free block is freed if there are too many of them
+         * @param memory aligned memory of the plane
+         * @param bytes size of the plane in bytes
+         */
+        void release(unsigned char *memory, std::size_t bytes);
+        /**
+         * @brief Make a plane that returns its memory to the pool when no image uses it
+         * @param memory aligned memory of the plane
+         * @param bytes size of the plane in bytes
+         * @return Plane owning the memory
+         */
+        std::shared_ptr<unsigned char> wrap(unsigned char *memory, std::size_t bytes);
+
+    public:
+        /**
+         * @brief Constructor of an empty pool
+         * @param limit maximal number of free blocks that are kept
+         */
+        explicit PlanePool(std::size_t limit);
+        /**
+         * @brief Destructor that frees all free blocks
+         */
+        ~PlanePool();
+        PlanePool(const PlanePool &) = delete;
+        PlanePool &operator=(const PlanePool &) = delete;
+        /**
+         * @brief Pool shared by all images, it keeps blocks of two colour images
+         * @return Shared pool
+         */
+        static PlanePool &instance();
+        /**
+         * @brief Take a free block of given size, free blocks of other sizes are freed, as images of their size are not processed anymore
+         * @param bytes size of the plane in bytes
+         * @return Plane with memory of a previously used plane(its samples are left as they were), nullptr if there is no free block of this size
+         */
+        std::shared_ptr<unsigned char> take(std::size_t bytes);
+        /**
+         * @brief Allocate new aligned memory of a plane
+         * @param bytes size of the plane in bytes
+         * @param alignment alignment of the memory, bytes must be its multiple
+         * @return Plane with uninitialised memory
+         */
+        std::shared_ptr<unsigned char> allocate(std::size_t bytes, std::size_t alignment);
+        /**
+         * @brief Free all free blocks
+         */
+        void trim();
+};
+
+
+#endif
@@ -0,0 +1,139 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef SCRATCH_HH
+#define SCRATCH_HH
+
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+
+/**
+ * @brief Arena of temporary buffers of filters, one per thread. Buffers are taken from one block of memory and given back together,
+ *        the block grows until it can hold all buffers of a filter, so filters that are repeated allocate nothing
+ */
+class Scratch {
+    private:
+        /**
+         * @brief Block of memory that buffers are taken from
+         */
+        struct Block {
+            /**
+             * @brief Aligned memory of the block
+             */
+            unsigned char *memory;
+            /**
+             * @brief Size of the block in bytes
+             */
+            std::size_t bytes;
+        };
+        /**
+         * @brief Blocks of the arena, there are more of them only until the outermost frame ends, then they are merged into one
+         */
+        std::vector<Block> blocks;
+        /**
+         * @brief Index of the block that buffers are taken from
+         */
+        std::size_t current = 0;
+        /**
+         * @brief Number of bytes of the current block that are taken
+         */
+        std::size_t used = 0;
+
+        Scratch() = default;
+        ~Scratch();
+        /**
+         * @brief Arena of current thread
+         * @return Arena that is used only by current thread
+         */
+        static Scratch &local();
+        /**
+         * @brief Take a buffer from the arena, a new block is allocated if the current one is too small
+         * @param bytes size of the buffer in bytes
+         * @return Aligned memory of the buffer
+         */
+        void *take(std::size_t bytes);
+        /**
+         * @brief Give back all buffers taken after a frame started
+         * @param block index of the current block when the frame started
+         * @param offset number of bytes of that block that were taken when the frame started
+         */
+        void rewind(std::size_t block, std::size_t offset);
+
+    public:
+        /**
+         * @brief Buffers taken through an object of this class are given back to the arena of current thread when it is destroyed,
+         *        frames of one thread must be destroyed in reverse order of their construction
+         */
+        class Frame {
+            private:
+                /**
+                 * @brief Arena of the thread that constructed the frame
+                 */
+                Scratch &arena;
+                /**
+                 * @brief Index of the current block when the frame started
+                 */
+                std::size_t block;
+                /**
+                 * @brief Number of bytes of that block that were taken when the frame started
+                 */
+                std::size_t offset;
+
+            public:
+                /**
+                 * @brief Constructor that starts a frame in the arena of current thread
+                 */
+                Frame();
+                /**
+                 * @brief Destructor that gives back all buffers of the frame
+                 */
+                ~Frame();
+                Frame(const Frame &) = delete;
+                Frame &operator=(const Frame &) = delete;
+                /**
+                 * @brief Take a buffer of samples or sums, it is valid until the frame is destroyed
+                 * @param count number of elements
+                 * @param value value of every element
+                 * @return Pointer to the first element
+                 */
+                template <typename T>
+                T *take(std::size_t count, T value);
+        };
+
+        Scratch(const Scratch &) = delete;
+        Scratch &operator=(const Scratch &) = delete;
+};
+
+
+template <typename T>
+T *Scratch::Frame::take(std::size_t count, T value) {
+    T *buffer = static_cast<T *>(this->arena.take(count * sizeof(T)));
+    std::fill(buffer, buffer + count, value);
+    return buffer;
+}
+
+
+#endif
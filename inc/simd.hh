@@ -0,0 +1,170 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef SIMD_HH
+#define SIMD_HH
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+/*
+ * Vectorized kernels of point filters, conversion to grey, convolution, gradient and median. Every kernel is compiled for SSE2, AVX2 and AVX-512,
+ * the widest instruction set supported by the processor is selected once, at startup.
+ */
+
+
+/**
+ * @brief Name of instruction set selected for vectorized kernels
+ * @return "AVX-512", "AVX2" or "SSE2"
+ */
+const char *simdInstructionSet();
+
+/**
+ * @brief Replace every sample with depth minus sample
+ * @param span pointer to the first sample
+ * @param size number of samples
+ * @param depth maximal value of a sample
+ */
+void negativeSpan(std::uint8_t *span, std::size_t size, int depth);
+void negativeSpan(std::uint16_t *span, std::size_t size, int depth);
+
+/**
+ * @brief Replace samples not greater than limit with below and the rest with above
+ * @param span pointer to the first sample
+ * @param size number of samples
+ * @param limit threshold value in range [0; depth]
+ * @param below new value of samples not greater than limit, -1 keeps the sample unchanged
+ * @param above new value of samples greater than limit, -1 keeps the sample unchanged
+ */
+void thresholdSpan(std::uint8_t *span, std::size_t size, int limit, int below, int above);
+void thresholdSpan(std::uint16_t *span, std::size_t size, int limit, int below, int above);
+
+/**
+ * @brief Level adjustment - samples not greater than black become 0, samples not less than white become depth,
+ *        the rest are multiplied by depth / (white - black) after black is subtracted
+ * @param span pointer to the first sample
+ * @param size number of samples
+ * @param black black level
+ * @param white white level, not less than black
+ * @param depth maximal value of a sample
+ */
+void levelSpan(std::uint8_t *span, std::size_t size, int black, int white, int depth);
+void levelSpan(std::uint16_t *span, std::size_t size, int black, int white, int depth);
+
+/**
+ * @brief Mean of three colours rounded down, grey may be the same span as one of the colours
+ * @param red pointer to the first red sample
+ * @param green pointer to the first green sample
+ * @param blue pointer to the first blue sample
+ * @param grey pointer to the first grey sample
+ * @param size number of samples
+ */
+void meanSpan(const std::uint8_t *red, const std::uint8_t *green, const std::uint8_t *blue, std::uint8_t *grey, std::size_t size);
+void meanSpan(const std::uint16_t *red, const std::uint16_t *green, const std::uint16_t *blue, std::uint16_t *grey, std::size_t size);
+
+/**
+ * @brief Weighted sum of three colours rounded to the nearest integer, grey may be the same span as one of the colours
+ * @param red pointer to the first red sample
+ * @param green pointer to the first green sample
+ * @param blue pointer to the first blue sample
+ * @param grey pointer to the first grey sample
+ * @param size number of samples
+ * @param wr weight of red in units of 1/32768
+ * @param wg weight of green in units of 1/32768
+ * @param wb weight of blue in units of 1/32768, weights sum up to 32768
+ */
+void lumaSpan(const std::uint8_t *red, const std::uint8_t *green, const std::uint8_t *blue, std::uint8_t *grey, std::size_t size, int wr, int wg, int wb);
+void lumaSpan(const std::uint16_t *red, const std::uint16_t *green, const std::uint16_t *blue, std::uint16_t *grey, std::size_t size, int wr, int wg, int wb);
+
+
+/**
+ * @brief Convert samples to floats, e.g. before they are convolved
+ * @param span pointer to the first sample
+ * @param wide pointer to the first float
+ * @param size number of samples
+ */
+void widenSpan(const std::uint8_t *span, float *wide, std::size_t size);
+void widenSpan(const std::uint16_t *span, float *wide, std::size_t size);
+
+/**
+ * @brief Horizontal 1-D convolution - result[k] is the sum of span[k + t] * weights[t], loops of 3, 5 and 7 taps are unrolled
+ * @param span pointer to the first float, it holds size + taps - 1 floats
+ * @param result pointer to the first result
+ * @param size number of results
+ * @param weights weights of the kernel
+ * @param taps number of weights
+ */
+void convolveRowSpan(const float *span, float *result, std::size_t size, const float *weights, int taps);
+
+/**
+ * @brief Vertical 1-D convolution - result[k] is the sum of rows[t][k] * weights[t], rounded to the nearest integer and clamped to [0; depth]
+ * @param rows pointers to the first float of every row
+ * @param result pointer to the first sample of the result
+ * @param size number of samples
+ * @param weights weights of the kernel
+ * @param taps number of weights and rows
+ * @param depth maximal value of a sample
+ */
+void convolveColumnSpan(const float *const *rows, std::uint8_t *result, std::size_t size, const float *weights, int taps, int depth);
+void convolveColumnSpan(const float *const *rows, std::uint16_t *result, std::size_t size, const float *weights, int taps, int depth);
+
+
+/**
+ * @brief Magnitude of gradient of the middle one of three rows, divided by the sum of weights on one side of the operator,
+ *        rounded to the nearest integer and clamped to [0; depth], the nearest sample is used beyond the first and the last one
+ * @param above pointer to the first sample of the row above, the same as current in the first row
+ * @param current pointer to the first sample of the row
+ * @param below pointer to the first sample of the row below, the same as current in the last row
+ * @param result pointer to the first sample of the result, it must not be any of the rows
+ * @param size number of samples
+ * @param op operator - 0 for differences of neighbours, 1 for Sobel, 2 for Scharr
+ * @param norm 0 for sum of absolute values of components, 1 for euclidean length
+ * @param depth maximal value of a sample
+ */
+void gradientSpan(const std::uint8_t *above, const std::uint8_t *current, const std::uint8_t *below, std::uint8_t *result, std::size_t size, int op, int norm, int depth);
+void gradientSpan(const std::uint16_t *above, const std::uint16_t *current, const std::uint16_t *below, std::uint16_t *result, std::size_t size, int op, int norm, int depth);
+
+
+/**
+ * @brief One row of median filter from histograms of columns, coarse bins count high bits of samples(4 of 8-bit and 8 of 16-bit samples),
+ *        fine bins count whole samples, the window is made of given number of consecutive columns
+ * @param coarse coarse bins of every column, 16 for 8-bit and 256 for 16-bit samples
+ * @param fine fine bins of every column
+ * @param fine_bins number of fine bins of a column
+ * @param window_coarse coarse counts of the window
+ * @param window_fine fine counts of the window, fine_bins of them
+ * @param updated column at which fine counts of every coarse bin were updated, one for every coarse bin
+ * @param result pointer to the first sample of the result
+ * @param size number of samples, there are size + window - 1 columns
+ * @param window number of columns and rows of the window
+ * @param rank index of the median among sorted samples of the window
+ */
+void medianSpan(const std::uint8_t *coarse, const std::uint8_t *fine, std::size_t fine_bins, std::uint16_t *window_coarse, std::uint16_t *window_fine,
+                int *updated, std::uint8_t *result, std::size_t size, int window, int rank);
+void medianSpan(const std::uint8_t *coarse, const std::uint8_t *fine, std::size_t fine_bins, std::uint16_t *window_coarse, std::uint16_t *window_fine,
+                int *updated, std::uint16_t *result, std::size_t size, int window, int rank);
+
+
+#endif
@@ -0,0 +1,89 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef STREAM_HH
+#define STREAM_HH
+
+
+#include "image.hh"
+#include <functional>
+#include <string>
+
+
+/**
+ * @brief Processes an image in horizontal bands of rows, so that memory depends on size of a band instead of size of the image.
+ *        Every band is processed together with halo rows above and below it, which neighbourhood filters read, only rows of the band are written.
+ */
+class Stream {
+    private:
+        /**
+         * @brief Number of rows written after every band is processed
+         */
+        int band_rows;
+        /**
+         * @brief Number of rows above a band that filters need to compute it exactly
+         */
+        int above;
+        /**
+         * @brief Number of rows below a band that filters need to compute it exactly
+         */
+        int below;
+        /**
+         * @brief Rows of the input file that are kept for current and next band, they are never filtered
+         */
+        Image window;
+        /**
+         * @brief Current band with its halo rows, copied from window and filtered
+         */
+        Image band;
+        /**
+         * @brief Number of pixels of the last processed image
+         */
+        long long pixels = 0;
+
+    public:
+        /**
+         * @brief Constructor
+         * @param band_rows number of rows of a band, greater than 0
+         * @param above number of halo rows above every band
+         * @param below number of halo rows below every band
+         */
+        Stream(int band_rows, int above, int below);
+        /**
+         * @brief Read, filter and write an image band by band
+         * @param input path to image that is processed
+         * @param output path to which processed image is saved
+         * @param binary whether image is saved as binary(P5, P6) or text(P2, P3) file
+         * @param process function that filters a band as if it was a whole image, it must not change its height and width
+         * @return Boolean value - whether the operation was successful or not
+         */
+        bool run(const std::string &input, const std::string &output, bool binary, const std::function<bool(Image &)> &process);
+        /**
+         * @brief Get number of pixels of the last processed image
+         * @return Number of pixels
+         */
+        long long getPixels() const;
+};
+
+
+#endif
@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef SUMMED_AREA_HH
+#define SUMMED_AREA_HH
+
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+/**
+ * @brief Summed-area table(integral image) of one colour plane - entry (i, j) is the sum of samples above row i and left of column j,
+ *        so the sum of any rectangle is computed from four entries. Sums are 64-bit, so they do not overflow for 16-bit samples of any image that fits in memory
+ */
+class SummedArea {
+    private:
+        /**
+         * @brief Width of the plane, the table has one column more
+         */
+        int width;
+        /**
+         * @brief Height of the plane, the table has one row more
+         */
+        int height;
+        /**
+         * @brief Number of entries between the starts of two consecutive rows of the table
+         */
+        std::size_t stride;
+        /**
+         * @brief Entries row by row, the first row and the first column are zeros
+         */
+        std::unique_ptr<std::uint64_t[]> sums;
+
+        /**
+         * @brief Constructor of a table that is not filled yet
+         * @param width width of the plane
+         * @param height height of the plane
+         */
+        SummedArea(int width, int height);
+
+    public:
+        /**
+         * @brief Build table of a plane, rows are summed by all threads of the pool in parallel
+         * @param plane pointer to the first sample of the plane
+         * @param plane_stride number of samples between the starts of two consecutive rows of the plane
+         * @param width width of the plane
+         * @param height height of the plane
+         * @return Filled table
+         */
+        template <typename T>
+        static SummedArea build(const T *plane, std::size_t plane_stride, int width, int height);
+        /**
+         * @brief Get one row of the table
+         * @param i index of row in range [0; height]
+         * @return Pointer to the first entry of row i - sums of samples above row i, width + 1 entries
+         */
+        const std::uint64_t *row(int i) const;
+        /**
+         * @brief Sum of samples of a rectangle
+         * @param top first row of the rectangle
+         * @param left first column of the rectangle
+         * @param bottom row after the last row of the rectangle
+         * @param right column after the last column of the rectangle
+         * @return Sum of samples (i, j) for top <= i < bottom and left <= j < right
+         */
+        std::uint64_t sum(int top, int left, int bottom, int right) const;
+};
+
+
+inline const std::uint64_t *SummedArea::row(int i) const {
+    return this->sums.get() + std::size_t(i) * this->stride;
+}
+
+
+inline std::uint64_t SummedArea::sum(int top, int left, int bottom, int right) const {
+    const std::uint64_t *upper = this->row(top);
+    const std::uint64_t *lower = this->row(bottom);
+    return lower[right] - lower[left] - upper[right] + upper[left];
+}
+
+
+#endif
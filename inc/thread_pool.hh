@@ -0,0 +1,187 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef THREAD_POOL_HH
+#define THREAD_POOL_HH
+
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * @brief Pool of worker threads that processes images in horizontal bands of rows
+ */
+class ThreadPool {
+    private:
+        /**
+         * @brief Worker threads, calling thread works too, so there is one worker less than threads
+         */
+        std::vector<std::thread> workers;
+        /**
+         * @brief Number of threads that process bands, including calling thread
+         */
+        int threads = 1;
+        /**
+         * @brief Protects state of current job
+         */
+        std::mutex mutex;
+        /**
+         * @brief Only one job can be processed at a time, it is held by the thread that submitted current job
+         */
+        std::mutex submitting;
+        /**
+         * @brief Workers wait on it for a new job
+         */
+        std::condition_variable wake;
+        /**
+         * @brief Calling thread waits on it for the end of a job
+         */
+        std::condition_variable done;
+        /**
+         * @brief Function that processes one band of current job
+         */
+        const std::function<void(int, int)> *job = nullptr;
+        /**
+         * @brief Boundaries of bands of current job
+         */
+        const std::vector<int> *bounds = nullptr;
+        /**
+         * @brief Number of current job, workers use it to recognise new jobs
+         */
+        unsigned long generation = 0;
+        /**
+         * @brief Index of next band that has not been taken yet
+         */
+        std::atomic<int> next{0};
+        /**
+         * @brief Number of bands that have not been finished yet
+         */
+        std::atomic<int> remaining{0};
+        /**
+         * @brief Number of workers that are taking part in current job
+         */
+        int active = 0;
+        /**
+         * @brief Whether workers should finish
+         */
+        bool stopping = false;
+
+        /**
+         * @brief Main loop of worker thread
+         */
+        void workerLoop();
+        /**
+         * @brief Take and process bands of current job until there are no bands left
+         * @param body function that processes one band
+         * @param boundaries boundaries of bands
+         */
+        void work(const std::function<void(int, int)> &body, const std::vector<int> &boundaries);
+        /**
+         * @brief Start given number of threads
+         * @param count number of threads, including calling thread
+         */
+        void start(int count);
+        /**
+         * @brief Finish and join all workers
+         */
+        void stop();
+
+    public:
+        /**
+         * @brief While an object of this class exists, jobs submitted by current thread are processed by this thread only
+         */
+        class Sequential {
+            private:
+                /**
+                 * @brief Whether jobs of current thread were sequential before
+                 */
+                bool previous;
+
+            public:
+                /**
+                 * @brief Constructor that makes jobs of current thread sequential
+                 */
+                Sequential();
+                /**
+                 * @brief Destructor that restores previous behaviour
+                 */
+                ~Sequential();
+                Sequential(const Sequential &) = delete;
+                Sequential &operator=(const Sequential &) = delete;
+        };
+
+        /**
+         * @brief Constructor that starts the pool
+         * @param count number of threads, including calling thread
+         */
+        explicit ThreadPool(int count);
+        /**
+         * @brief Destructor that joins all workers
+         */
+        ~ThreadPool();
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+        /**
+         * @brief Pool shared by all images, by default it has one thread per core
+         * @return Shared pool
+         */
+        static ThreadPool &instance();
+        /**
+         * @brief Change number of threads, it must not be called while a job is processed
+         * @param count number of threads, including calling thread
+         */
+        void setThreads(int count);
+        /**
+         * @brief Get number of threads
+         * @return Number of threads, including calling thread
+         */
+        int getThreads() const;
+        /**
+         * @brief Split range of rows into bands, one band per thread, split depends only on range and number of threads
+         * @param begin first row of range
+         * @param end row after the last row of range
+         * @return Boundaries of bands - band k is [bounds[k]; bounds[k+1])
+         */
+        std::vector<int> split(int begin, int end) const;
+        /**
+         * @brief Process bands in parallel and wait until all of them are finished, if the pool is busy with a job of another thread bands are processed sequentially
+         * @param bounds boundaries of bands, e.g. returned by split
+         * @param body function called with first row and row after the last row of a band
+         */
+        void run(const std::vector<int> &bounds, const std::function<void(int, int)> &body);
+        /**
+         * @brief Split range of rows into bands and process them in parallel
+         * @param begin first row of range
+         * @param end row after the last row of range
+         * @param body function called with first row and row after the last row of a band
+         */
+        void parallelFor(int begin, int end, const std::function<void(int, int)> &body);
+};
+
+
+#endif
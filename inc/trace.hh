@@ -0,0 +1,191 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef TRACE_HH
+#define TRACE_HH
+
+
+/*
+ * Opt-in instrumentation of hot paths. When the program is compiled with TRACING defined(make TRACE=1),
+ * every span records its time and counters of bytes read and written, pixels and allocations. At exit the spans are written
+ * as Chrome trace events(chrome://tracing, Perfetto) to the file given by IMAGE_TRACE environment variable(trace.json by default)
+ * and a summary table is printed to standard error. Without TRACING all macros expand to nothing.
+ */
+
+
+#ifdef TRACING
+
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+/**
+ * @brief Kinds of counters recorded by spans
+ */
+enum TraceCounter {
+    TRACE_BYTES_READ,
+    TRACE_BYTES_WRITTEN,
+    TRACE_PIXELS,
+    TRACE_ALLOCATIONS,
+    TRACE_COUNTERS
+};
+
+
+/**
+ * @brief Finished span, as it is written to the trace
+ */
+struct TraceEvent {
+    /**
+     * @brief Name of the span, string literal
+     */
+    const char *name;
+    /**
+     * @brief Start of the span in nanoseconds since start of the program
+     */
+    std::int64_t start;
+    /**
+     * @brief Duration of the span in nanoseconds
+     */
+    std::int64_t duration;
+    /**
+     * @brief Number of thread that recorded the span
+     */
+    int thread;
+    /**
+     * @brief Counters recorded by the span and the spans nested in it
+     */
+    std::uint64_t counters[TRACE_COUNTERS];
+};
+
+
+/**
+ * @brief Collects finished spans of all threads and writes them at exit
+ */
+class Tracer {
+    private:
+        /**
+         * @brief Time when the program started
+         */
+        std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+        /**
+         * @brief Protects events
+         */
+        std::mutex mutex;
+        /**
+         * @brief Finished spans in order of their ends
+         */
+        std::vector<TraceEvent> events;
+
+        /**
+         * @brief Constructor
+         */
+        Tracer() {};
+        /**
+         * @brief Destructor that writes the trace and prints the summary
+         */
+        ~Tracer();
+        /**
+         * @brief Write spans as Chrome trace events
+         * @param file_name path to the file
+         */
+        void writeTrace(const std::string &file_name) const;
+        /**
+         * @brief Print total time and counters of spans with the same name
+         */
+        void printSummary() const;
+
+    public:
+        /**
+         * @brief Tracer shared by all threads
+         * @return Shared tracer
+         */
+        static Tracer &instance();
+        /**
+         * @brief Get time since start of the program
+         * @return Number of nanoseconds
+         */
+        std::int64_t now() const;
+        /**
+         * @brief Store finished span
+         * @param event finished span
+         */
+        void record(const TraceEvent &event);
+};
+
+
+/**
+ * @brief Span of time that lasts as long as the object exists, counters are added to the innermost span of current thread
+ */
+class TraceSpan {
+    private:
+        /**
+         * @brief Recorded event
+         */
+        TraceEvent event;
+        /**
+         * @brief Span that was the innermost one when this span started
+         */
+        TraceSpan *parent;
+
+    public:
+        /**
+         * @brief Constructor that starts the span
+         * @param name name of the span, string literal
+         */
+        explicit TraceSpan(const char *name);
+        /**
+         * @brief Destructor that finishes the span, its counters are added to its parent
+         */
+        ~TraceSpan();
+        TraceSpan(const TraceSpan &) = delete;
+        TraceSpan &operator=(const TraceSpan &) = delete;
+        /**
+         * @brief Add value to a counter of the innermost span of current thread, nothing happens outside of spans
+         * @param counter kind of counter
+         * @param value added value
+         */
+        static void count(TraceCounter counter, std::uint64_t value);
+};
+
+
+#define TRACE_JOIN_(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN_(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_JOIN(trace_span_, __LINE__)(name)
+#define TRACE_COUNT(counter, value) TraceSpan::count(counter, value)
+
+
+#else
+
+
+#define TRACE_SPAN(name) do {} while(false)
+#define TRACE_COUNT(counter, value) do {} while(false)
+
+
+#endif
+
+
+#endif
@@ -0,0 +1,194 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/batch.hh"
+#include "../inc/trace.hh"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <glob.h>
+#include <iomanip>
+#include <system_error>
+#include <thread>
+
+
+Batch::Batch(std::vector<std::string> files) : files(std::move(files)) {
+    std::vector<std::size_t> sizes;
+
+    for(const std::string &file : this->files) {
+        std::error_code error;
+        std::size_t size = std::filesystem::file_size(file, error);
+        sizes.push_back(error ? 0 : size);
+    }
+
+    // the largest files first, so that they do not finish last
+    std::vector<int> order(this->files.size());
+    for(std::size_t k = 0; k < order.size(); ++k) {
+        order[k] = int(k);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return sizes[a] > sizes[b]; });
+
+    std::vector<std::string> sorted;
+    for(int k : order) {
+        sorted.push_back(this->files[k]);
+        this->results.emplace_back();
+        this->results.back().file = this->files[k];
+        this->results.back().bytes = sizes[k];
+    }
+    this->files = std::move(sorted);
+}
+
+
+bool Batch::collect(const std::string &source, std::vector<std::string> &found) {
+    std::error_code error;
+    std::size_t before = found.size();
+
+    if(std::filesystem::is_directory(source, error)) {
+        std::vector<std::string> entries;
+        for(const auto &entry : std::filesystem::directory_iterator(source, error)) {
+            std::string extension = entry.path().extension().string();
+            if(entry.is_regular_file(error) && (extension == ".pgm" || extension == ".ppm" || extension == ".pnm")) {
+                entries.push_back(entry.path().string());
+            }
+        }
+        std::sort(entries.begin(), entries.end());
+        found.insert(found.end(), entries.begin(), entries.end());
+    }
+    else {
+        glob_t matches;
+        if(glob(source.c_str(), 0, nullptr, &matches) == 0) {
+            for(std::size_t k = 0; k < matches.gl_pathc; ++k) {
+                if(std::filesystem::is_regular_file(matches.gl_pathv[k], error)) {
+                    found.push_back(matches.gl_pathv[k]);
+                }
+            }
+        }
+        globfree(&matches);
+    }
+
+    if(found.size() == before) {
+        std::cerr << "Error. No images found in " << source << ".\n";
+        return false;
+    }
+    return true;
+}
+
+
+bool Batch::take(int thread, int &index) {
+    int threads = int(this->queues.size());
+
+    {
+        std::lock_guard<std::mutex> lock(this->locks[thread]);
+        if(!this->queues[thread].empty()) {
+            index = this->queues[thread].front();
+            this->queues[thread].pop_front();
+            return true;
+        }
+    }
+
+    // own queue is empty - steal from the others, starting with the next thread
+    for(int k = 1; k < threads; ++k) {
+        int victim = (thread + k) % threads;
+        std::lock_guard<std::mutex> lock(this->locks[victim]);
+        if(!this->queues[victim].empty()) {
+            index = this->queues[victim].back();
+            this->queues[victim].pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void Batch::work(int thread, const std::function<bool(const std::string &, BatchResult &)> &process) {
+    int index;
+
+    while(this->take(thread, index)) {
+        TRACE_SPAN("Batch::file");
+        BatchResult &result = this->results[index];
+        auto start = std::chrono::steady_clock::now();
+        result.success = process(this->files[index], result);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+
+void Batch::run(int threads, const std::function<bool(const std::string &, BatchResult &)> &process) {
+    int count = std::max(1, std::min(threads, int(this->files.size())));
+    std::vector<std::thread> workers;
+
+    // files are dealt like cards, so that every queue gets both large and small files
+    this->queues.assign(count, std::deque<int>());
+    this->locks = std::vector<std::mutex>(count);
+    for(std::size_t k = 0; k < this->files.size(); ++k) {
+        this->queues[k % count].push_back(int(k));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for(int t = 1; t < count; ++t) {
+        workers.emplace_back(&Batch::work, this, t, std::cref(process));
+    }
+    this->work(0, process);
+    for(std::thread &worker : workers) {
+        worker.join();
+    }
+    this->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+void Batch::report(std::ostream &out) const {
+    long long pixels = 0;
+    std::size_t bytes = 0;
+    double busy = 0;
+    std::ios_base::fmtflags flags = out.flags();
+
+    out << std::fixed << std::setprecision(3);
+    for(const BatchResult &result : this->results) {
+        double megapixels = result.pixels / 1e6;
+        out << result.file << ": ";
+        if(result.success) {
+            out << megapixels << " MP, " << result.seconds << " s, "
+                << megapixels / std::max(result.seconds, 1e-9) << " MP/s, "
+                << result.bytes / 1e6 / std::max(result.seconds, 1e-9) << " MB/s\n";
+            pixels += result.pixels;
+            bytes += result.bytes;
+        }
+        else {
+            out << "failed\n";
+        }
+        busy += result.seconds;
+    }
+
+    out << "Total: " << this->results.size() - this->failures() << " of " << this->results.size() << " files, "
+        << pixels / 1e6 << " MP, " << this->seconds << " s, "
+        << pixels / 1e6 / std::max(this->seconds, 1e-9) << " MP/s, "
+        << bytes / 1e6 / std::max(this->seconds, 1e-9) << " MB/s, "
+        << this->results.size() / std::max(this->seconds, 1e-9) << " files/s, "
+        << busy / std::max(this->seconds, 1e-9) << " files processed at once on average\n";
+    out.flags(flags);
+}
+
+
+int Batch::failures() const {
+    return int(std::count_if(this->results.begin(), this->results.end(), [](const BatchResult &result) { return !result.success; }));
+}
@@ -0,0 +1,372 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/convolution_kernel.hh"
+#include "../inc/image.hh"
+#include "../inc/netpbm.hh"
+#include "../inc/simd.hh"
+#include "../inc/thread_pool.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+
+/**
+ * @brief Time statistics of one method measured on one image
+ */
+struct Measurement {
+    /**
+     * @brief Description of the image, e.g. PPM 16-bit
+     */
+    std::string image;
+    /**
+     * @brief Name of measured method
+     */
+    std::string method;
+    /**
+     * @brief Width of the image
+     */
+    int width;
+    /**
+     * @brief Height of the image
+     */
+    int height;
+    /**
+     * @brief Maximal value of a sample
+     */
+    int depth;
+    /**
+     * @brief Mean time of one repetition in seconds
+     */
+    double mean;
+    /**
+     * @brief The shortest repetition in seconds
+     */
+    double min;
+    /**
+     * @brief Sample variance of time of repetitions in seconds squared
+     */
+    double variance;
+};
+
+
+/**
+ * @brief Print usage of the benchmark
+ */
+static void printUsage() {
+    std::cerr << "Usage: benchmark [-s sizes] [-d depths] [-r repeats] [-j threads] [-o json]\n";
+    std::cerr << "  -s sizes     comma separated sizes of images in megapixels(default 1,10,100)\n";
+    std::cerr << "  -d depths    comma separated maximal values of samples(default 255,65535)\n";
+    std::cerr << "  -r repeats   number of repetitions of every method(default 5)\n";
+    std::cerr << "  -j threads   number of threads used by filters(default one per core)\n";
+    std::cerr << "  -o json      file to which results are written as JSON(default bench.json)\n";
+}
+
+
+/**
+ * @brief Parse comma separated list of positive numbers
+ * @param text list of numbers
+ * @param values parsed numbers
+ * @return Boolean value - whether the list is correct or not
+ */
+static bool parseList(const std::string &text, std::vector<double> &values) {
+    std::stringstream list(text);
+    std::string item;
+
+    values.clear();
+    while(std::getline(list, item, ',')) {
+        char *end = nullptr;
+        double value = std::strtod(item.c_str(), &end);
+        if(item.empty() || *end != '\0' || value <= 0) {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+
+/**
+ * @brief Write synthetic image - smooth gradients with noise, so that every value of a sample is used, T must be the sample type of the depth
+ * @param file_name path to the file
+ * @param img_type 1 for PGM, 3 for PPM
+ * @param width width of image
+ * @param height height of image
+ * @param depth maximal value of a sample
+ * @return Boolean value - whether the operation was successful or not
+ */
+template <typename T>
+static bool generate(const std::string &file_name, int img_type, int width, int height, int depth) {
+    NetpbmWriter file;
+    std::vector<T> rows(std::size_t(img_type) * width);
+    std::uint32_t state = 2463534242u;
+
+    if(!file.open(file_name, img_type, width, height, depth)) {
+        return false;
+    }
+    for(int i = 0; i < height; ++i) {
+        const T *planes[3];
+        for(int c = 0; c < img_type; ++c) {
+            T *row = rows.data() + std::size_t(c) * width;
+            for(int j = 0; j < width; ++j) {
+                // xorshift noise on top of diagonal gradient
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                double gradient = double(i + j + c * width / 3) / (width + height);
+                double value = depth * (gradient - std::floor(gradient)) + (int(state % 33) - 16) * (depth / 255.0);
+                row[j] = T(std::clamp(value, 0.0, double(depth)));
+            }
+            planes[c] = row;
+        }
+        if(!file.writeRows(1, planes, 0)) {
+            return false;
+        }
+    }
+    return file.close();
+}
+
+
+/**
+ * @brief Measure time of one method, every repetition processes a fresh copy of the image
+ * @param source loaded image that is copied before every repetition, nullptr when method does not need an image
+ * @param repeats number of repetitions
+ * @param method measured method
+ * @param result mean, minimum and variance of measured times are stored to it
+ * @return Boolean value - whether every repetition was successful or not
+ */
+static bool measure(const Image *source, int repeats, const std::function<bool(Image &)> &method, Measurement &result) {
+    std::vector<double> times;
+    Image work;
+
+    for(int k = 0; k < repeats; ++k) {
+        if(source) {
+            work.create(source->getType(), source->getWidth(), source->getHeight(), source->getDepth());
+            work.copyRows(*source, 0, 0, source->getHeight());
+        }
+        auto start = std::chrono::steady_clock::now();
+        if(!method(work)) {
+            return false;
+        }
+        times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    double sum = 0;
+    for(double time : times) {
+        sum += time;
+    }
+    result.mean = sum / repeats;
+    result.min = *std::min_element(times.begin(), times.end());
+    result.variance = 0;
+    for(double time : times) {
+        result.variance += (time - result.mean) * (time - result.mean);
+    }
+    result.variance /= std::max(repeats - 1, 1);
+    return true;
+}
+
+
+/**
+ * @brief Print one measurement as a row of a table
+ * @param result measurement
+ */
+static void printRow(const Measurement &result) {
+    double pixels = double(result.width) * result.height;
+    double deviation = std::sqrt(result.variance);
+
+    std::cout << "  " << std::left << std::setw(24) << result.method << std::right
+              << std::setw(10) << result.mean * 1e3 << " ms"
+              << std::setw(10) << deviation * 1e3 << " ms"
+              << std::setw(7) << (result.mean > 0 ? 100 * deviation / result.mean : 0) << " %"
+              << std::setw(10) << pixels / result.mean / 1e6 << " MP/s"
+              << std::setw(9) << result.mean * 1e9 / pixels << " ns/px\n";
+}
+
+
+/**
+ * @brief Write all measurements as JSON
+ * @param file_name path to the file
+ * @param results measurements
+ * @param repeats number of repetitions of every method
+ * @return Boolean value - whether the operation was successful or not
+ */
+static bool writeJson(const std::string &file_name, const std::vector<Measurement> &results, int repeats) {
+    std::ofstream json(file_name);
+
+    json << std::setprecision(9);
+    json << "{\n";
+    json << "  \"threads\": " << ThreadPool::instance().getThreads() << ",\n";
+    json << "  \"instruction_set\": \"" << simdInstructionSet() << "\",\n";
+    json << "  \"repeats\": " << repeats << ",\n";
+    json << "  \"results\": [\n";
+    for(std::size_t k = 0; k < results.size(); ++k) {
+        const Measurement &result = results[k];
+        double pixels = double(result.width) * result.height;
+        json << "    {\"image\": \"" << result.image << "\", \"method\": \"" << result.method << "\", "
+             << "\"width\": " << result.width << ", \"height\": " << result.height << ", \"depth\": " << result.depth << ", "
+             << "\"megapixels\": " << pixels / 1e6 << ", \"mean_s\": " << result.mean << ", \"min_s\": " << result.min << ", "
+             << "\"variance_s2\": " << result.variance << ", \"mp_per_s\": " << pixels / result.mean / 1e6 << ", "
+             << "\"ns_per_px\": " << result.mean * 1e9 / pixels << "}" << (k + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n";
+    json << "}\n";
+    return json.good();
+}
+
+
+int main(int argc, char *argv[]) {
+    std::vector<double> sizes = {1, 10, 100};
+    std::vector<double> depths = {255, 65535};
+    std::vector<double> values;
+    int repeats = 5;
+    std::string json = "bench.json";
+
+    for(int k = 1; k < argc; ++k) {
+        std::string argument = argv[k];
+        bool has_value = (k + 1 < argc);
+
+        if(argument == "-s" && has_value && parseList(argv[k+1], sizes)) {
+            ++k;
+        }
+        else if(argument == "-d" && has_value && parseList(argv[k+1], depths)) {
+            ++k;
+        }
+        else if(argument == "-r" && has_value && parseList(argv[k+1], values) && values.size() == 1) {
+            repeats = int(values[0]);
+            ++k;
+        }
+        else if(argument == "-j" && has_value && parseList(argv[k+1], values) && values.size() == 1) {
+            ThreadPool::instance().setThreads(int(values[0]));
+            ++k;
+        }
+        else if(argument == "-o" && has_value) {
+            json = argv[++k];
+        }
+        else {
+            printUsage();
+            return argument == "-h" ? 0 : 1;
+        }
+    }
+    for(double depth : depths) {
+        if(depth != std::floor(depth) || depth > 65535) {
+            std::cerr << "Unsupported depth of an image.\n";
+            return 1;
+        }
+    }
+    repeats = std::max(repeats, 1);
+
+    // synthetic images are written to a temporary directory, which is removed at the end
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / ("image-processing-bench-" + std::to_string(getpid()));
+    std::filesystem::create_directories(directory);
+    std::vector<Measurement> results;
+    bool success = true;
+
+    std::cout << "Threads: " << ThreadPool::instance().getThreads() << ", instruction set: " << simdInstructionSet()
+              << ", repetitions: " << repeats << "\n" << std::fixed << std::setprecision(2);
+
+    for(double size : sizes) {
+        // images have 4:3 aspect ratio
+        int width = std::max(2, int(std::lround(std::sqrt(size * 1e6 * 4 / 3))));
+        int height = std::max(2, int(std::lround(size * 1e6 / width)));
+        for(double depth : depths) {
+            for(int img_type : {1, 3}) {
+                std::string extension = (img_type == 1 ? ".pgm" : ".ppm");
+                std::string image = std::string(img_type == 1 ? "PGM" : "PPM") + " " + (depth <= 255 ? "8" : "16") + "-bit";
+                std::string binary_file = (directory / ("binary" + extension)).string();
+                std::string text_file = (directory / ("text" + extension)).string();
+                Image source;
+
+                std::cout << "\n" << image << ", depth " << int(depth) << ", " << width << "x" << height
+                          << " (" << double(width) * height / 1e6 << " MP)\n";
+                bool generated = (depth <= 255 ? generate<std::uint8_t>(binary_file, img_type, width, height, int(depth))
+                                               : generate<std::uint16_t>(binary_file, img_type, width, height, int(depth)));
+                if(!generated || !source.loadFile(binary_file)) {
+                    success = false;
+                    continue;
+                }
+
+                std::vector<std::pair<std::string, std::function<bool(Image &)>>> methods = {
+                    {"saveFile P5/P6", [&](Image &img) { return img.saveFile(binary_file, true); }},
+                    {"saveFile P2/P3", [&](Image &img) { return img.saveFile(text_file, false); }},
+                    {"loadFile P5/P6", [&](Image &img) { return img.loadFile(binary_file); }},
+                    {"loadFile P2/P3", [&](Image &img) { return img.loadFile(text_file); }},
+                    {"negative", [](Image &img) { img.negative(); return true; }},
+                    {"thresholding", [](Image &img) { img.thresholding(0.5); return true; }},
+                    {"halfThresholdingBlack", [](Image &img) { img.halfThresholdingBlack(0.5); return true; }},
+                    {"halfThresholdingWhite", [](Image &img) { img.halfThresholdingWhite(0.5); return true; }},
+                    {"gammaCorrection", [](Image &img) { img.gammaCorrection(2.2); return true; }},
+                    {"levelAdjustment", [](Image &img) { img.levelAdjustment(0.2); return true; }},
+                    {"contouring", [](Image &img) { img.gradient(); return true; }},
+                    {"sobelGradient", [](Image &img) { img.gradient(Image::SOBEL, Image::L2); return true; }},
+                    {"horizontalBlurring", [](Image &img) { img.horizontalBlurring(5); return true; }},
+                    {"verticalBlurring", [](Image &img) { img.verticalBlurring(5); return true; }},
+                    {"fullBlurring", [](Image &img) { img.fullBlurring(5); return true; }},
+                    {"medianFiltering", [](Image &img) { img.medianFiltering(2); return true; }},
+                    {"gaussianBlurring", [](Image &img) { img.convolution(ConvolutionKernel::gaussian(3)); return true; }},
+                    {"sharpening", [](Image &img) { img.convolution(ConvolutionKernel::sharpen(1)); return true; }},
+                    {"histogramStretching", [](Image &img) { img.histogramStretching(); return true; }},
+                    {"histogramEqualization", [](Image &img) { img.histogramEqualization(); return true; }},
+                    {"percentileStretching", [](Image &img) { img.percentileStretching(0.01); return true; }},
+                };
+                if(img_type == 3) {
+                    methods.push_back({"conversion2grey", [](Image &img) { return img.conversion2grey(); }});
+                    methods.push_back({"conversion2greyBT709", [](Image &img) { return img.conversion2grey(Image::BT709); }});
+                }
+
+                for(const auto &method : methods) {
+                    Measurement result = {image, method.first, width, height, int(depth), 0, 0, 0};
+                    // loading replaces the whole image, so there is nothing to copy
+                    bool loaded = (method.first.compare(0, 4, "load") == 0);
+                    if(!measure(loaded ? nullptr : &source, repeats, method.second, result)) {
+                        success = false;
+                        continue;
+                    }
+                    results.push_back(result);
+                    printRow(result);
+                }
+                std::filesystem::remove(binary_file);
+                std::filesystem::remove(text_file);
+            }
+        }
+    }
+
+    std::filesystem::remove_all(directory);
+    if(!writeJson(json, results, repeats)) {
+        std::cerr << "Error. Could not write " << json << ".\n";
+        return 1;
+    }
+    std::cout << "\nResults written to " << json << "\n";
+    return success ? 0 : 1;
+}
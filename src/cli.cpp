@@ -0,0 +1,657 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/cli.hh"
+#include "../inc/batch.hh"
+#include "../inc/convolution_kernel.hh"
+#include "../inc/image.hh"
+#include "../inc/pipeline.hh"
+#include "../inc/stream.hh"
+#include "../inc/thread_pool.hh"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+#define FAIL false;
+#define SUCCESS true;
+// images with at least so many pixels use all threads of the pool in batch mode, smaller ones are processed by one thread
+#define BATCH_LARGE (1 << 21)
+
+
+/**
+ * @brief Filter given as an argument, with checked parameter
+ */
+struct Filter {
+    /**
+     * @brief Name of filter, e.g. gamma
+     */
+    std::string name;
+    /**
+     * @brief Parameter of filter - threshold, gamma, level, radius, standard deviation, amount, clip, operator of gradient or index of colour, the greatest one when every colour has its own
+     */
+    double value = 0;
+    /**
+     * @brief Parameter of every colour when a list is given(e.g. gamma=2.2,1.8,2.0), empty otherwise
+     */
+    std::vector<double> values;
+    /**
+     * @brief Weights of a custom convolution kernel row by row(kernel=...), empty for other filters
+     */
+    std::vector<double> weights;
+    /**
+     * @brief Magnitude of gradient(contour=...,l2), L1 for other filters
+     */
+    Image::GradientNorm norm = Image::L1;
+};
+
+
+/**
+ * @brief Filters and options shared by all processed images
+ */
+struct Settings {
+    /**
+     * @brief Filters applied in given order
+     */
+    std::vector<Filter> filters;
+    /**
+     * @brief Whether images are saved as binary(P5, P6) or text(P2, P3) files
+     */
+    bool binary = true;
+    /**
+     * @brief Number of rows of a band when images are streamed, 0 when they are loaded at once
+     */
+    int band_rows = 0;
+};
+
+
+/**
+ * @brief Print usage of command line mode
+ */
+static void printUsage() {
+    std::cerr << "Usage: run -i input -o output [-t] [-j threads] [-m rows] [-s script] [filter...]\n";
+    std::cerr << "       run -b images -o directory [-t] [-j threads] [-m rows] [-s script] [filter...]\n";
+    std::cerr << "  -i input     image to be processed(PGM or PPM)\n";
+    std::cerr << "  -o output    file to which processed image is saved, directory in batch mode\n";
+    std::cerr << "  -b images    directory or pattern(e.g. \"pic/k*.ppm\") of images processed in parallel\n";
+    std::cerr << "  -t           save output as text(P2/P3) instead of binary(P5/P6)\n";
+    std::cerr << "  -j threads   number of threads used by filters\n";
+    std::cerr << "  -m rows      stream images in bands of rows, memory depends on size of a band instead of the image\n";
+    std::cerr << "  -s script    file with filters separated by whitespaces, # starts a comment\n";
+    std::cerr << "Filters are applied in given order:\n";
+    std::cerr << "  colour=r|g|b|all  select colour that will be processed(only for colorful images)\n";
+    std::cerr << "  grey[=mean|601|709]  convert PPM to PGM with mean of colours(default) or luma of BT.601 or BT.709,\n";
+    std::cerr << "                when it is the first filter, image is converted while it is loaded\n";
+    std::cerr << "  negative      threshold=T   black=T   white=T   (T in range(0; 1))\n";
+    std::cerr << "  gamma=G       level=L(L in range(0; 0.5))   stretch\n";
+    std::cerr << "  contour[=diff|sobel|scharr][,l1|l2]  magnitude of gradient, sum of absolute values(l1, default) or length(l2)\n";
+    std::cerr << "  equalize      clip=P(stretch ignoring fraction P in range[0; 0.5) at both ends of the histogram)\n";
+    std::cerr << "  hblur=R       vblur=R       blur=R   (R - radius, greater than 0)\n";
+    std::cerr << "  median=R(R - radius in range[1; 127], removes salt-and-pepper noise)\n";
+    std::cerr << "  gauss=S(S - standard deviation in range(0; 20])   sharpen=A(A - amount, greater than 0)\n";
+    std::cerr << "  kernel=W,W,...  convolution with 9, 25, 49... weights row by row, divided by their sum unless it is 0\n";
+    std::cerr << "Every colour gets its own parameter when three are given, e.g. gamma=2.2,1.8,2.0\n";
+}
+
+
+/**
+ * @brief Parse floating point number
+ * @param text text of number
+ * @param value parsed number
+ * @return Boolean value - whether the whole text is a number or not
+ */
+static bool parseDouble(const std::string &text, double &value) {
+    char *end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+
+/**
+ * @brief Parse integer number
+ * @param text text of number
+ * @param value parsed number
+ * @return Boolean value - whether the whole text is a number that fits in int or not
+ */
+static bool parseInteger(const std::string &text, int &value) {
+    char *end = nullptr;
+    errno = 0;
+    long number = std::strtol(text.c_str(), &end, 10);
+    // numbers that do not fit in int are rejected instead of being truncated
+    if(text.empty() || *end != '\0' || errno == ERANGE || number < INT_MIN || number > INT_MAX) {
+        return FAIL;
+    }
+    value = int(number);
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Read filters from a script file
+ * @param file_name path to the script
+ * @param filters read filters are appended to it
+ * @return Boolean value - whether the operation was successful or not
+ */
+static bool readScript(const std::string &file_name, std::vector<std::string> &filters) {
+    std::ifstream script(file_name);
+    std::string line;
+
+    if(!script.good()) {
+        std::cerr << "Error. Could not read script " << file_name << ".\n";
+        return FAIL;
+    }
+    while(std::getline(script, line)) {
+        std::size_t comment = line.find('#');
+        if(comment != std::string::npos) {
+            line.erase(comment);
+        }
+        std::size_t begin = line.find_first_not_of(" \t\r");
+        while(begin != std::string::npos) {
+            std::size_t end = line.find_first_of(" \t\r", begin);
+            filters.push_back(line.substr(begin, end - begin));
+            begin = line.find_first_not_of(" \t\r", end);
+        }
+    }
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Parse one filter given as name=value and check its parameter
+ * @param text filter with its parameter
+ * @param filter parsed filter
+ * @return Boolean value - whether the filter is correct or not
+ */
+static bool parseFilter(const std::string &text, Filter &filter) {
+    std::size_t equals = text.find('=');
+    std::string value = (equals == std::string::npos ? "" : text.substr(equals + 1));
+    int radius = 0;
+
+    filter.name = text.substr(0, equals);
+
+    // list of parameters, one for every colour, every one is checked as a parameter of a single filter
+    if(value.find(',') != std::string::npos && filter.name != "colour" && filter.name != "grey" && filter.name != "kernel" && filter.name != "contour") {
+        std::size_t begin = 0;
+        filter.values.clear();
+        while(begin <= value.size()) {
+            std::size_t end = std::min(value.find(',', begin), value.size());
+            Filter single;
+            if(!parseFilter(filter.name + "=" + value.substr(begin, end - begin), single)) {
+                return FAIL;
+            }
+            filter.values.push_back(single.value);
+            begin = end + 1;
+        }
+        if(filter.values.size() != 3) {
+            std::cerr << "Error. Filter " << text << " needs one parameter for every colour.\n";
+            return FAIL;
+        }
+        filter.value = *std::max_element(filter.values.begin(), filter.values.end());
+        return SUCCESS;
+    }
+
+    if(filter.name == "grey" && (value == "mean" || value == "601" || value == "709")) {
+        filter.value = (value == "601" ? Image::BT601 : value == "709" ? Image::BT709 : Image::AVERAGE);
+        return SUCCESS;
+    }
+    else if(filter.name == "contour") {
+        // operator and magnitude, either of them may be omitted, e.g. contour=sobel,l2 or contour=l2
+        filter.value = Image::DIFFERENCES;
+        std::size_t begin = 0;
+        while(equals != std::string::npos && begin <= value.size()) {
+            std::size_t end = std::min(value.find(',', begin), value.size());
+            std::string option = value.substr(begin, end - begin);
+            if(option == "diff" || option == "sobel" || option == "scharr") {
+                filter.value = (option == "sobel" ? Image::SOBEL : option == "scharr" ? Image::SCHARR : Image::DIFFERENCES);
+            }
+            else if(option == "l1" || option == "l2") {
+                filter.norm = (option == "l2" ? Image::L2 : Image::L1);
+            }
+            else {
+                std::cerr << "Error. Improper option of contour " << option << ".\n";
+                return FAIL;
+            }
+            begin = end + 1;
+        }
+        return SUCCESS;
+    }
+    else if(filter.name == "negative" || filter.name == "stretch" || filter.name == "equalize" || filter.name == "grey") {
+        filter.value = Image::AVERAGE;
+        if(equals == std::string::npos) {
+            return SUCCESS;
+        }
+    }
+    else if(filter.name == "colour" && value == "all") {
+        filter.value = Image::ALL_COLOURS;
+        return SUCCESS;
+    }
+    else if(filter.name == "colour" && value.size() == 1) {
+        std::string colours = "rgb";
+        std::size_t c = colours.find(value[0]);
+        if(c == std::string::npos) {
+            std::cerr << "Error. Improper colour " << value << ".\n";
+            return FAIL;
+        }
+        filter.value = c;
+        return SUCCESS;
+    }
+    else if((filter.name == "threshold" || filter.name == "black" || filter.name == "white") && parseDouble(value, filter.value)) {
+        if(filter.value < 0 || filter.value > 1) {
+            std::cerr << "Improper value of threshold.\n";
+            return FAIL;
+        }
+        return SUCCESS;
+    }
+    else if(filter.name == "gamma" && parseDouble(value, filter.value)) {
+        if(filter.value <= 0) {
+            std::cerr << "Improper value of gamma parameter.\n";
+            return FAIL;
+        }
+        return SUCCESS;
+    }
+    else if(filter.name == "level" && parseDouble(value, filter.value)) {
+        if(filter.value <= 0 || filter.value >= 0.5) {
+            std::cerr << "Improper value of level.\n";
+            return FAIL;
+        }
+        return SUCCESS;
+    }
+    else if(filter.name == "clip" && parseDouble(value, filter.value)) {
+        if(filter.value < 0 || filter.value >= 0.5) {
+            std::cerr << "Improper value of clip.\n";
+            return FAIL;
+        }
+        return SUCCESS;
+    }
+    else if(filter.name == "hblur" || filter.name == "vblur" || filter.name == "blur") {
+        if(!parseInteger(value, radius) || radius <= 0) {
+            std::cerr << "Improper value of radius.\n";
+            return FAIL;
+        }
+        filter.value = radius;
+        return SUCCESS;
+    }
+    else if(filter.name == "median") {
+        if(!parseInteger(value, radius) || radius <= 0 || radius > Image::MAX_MEDIAN_RADIUS) {
+            std::cerr << "Improper value of radius.\n";
+            return FAIL;
+        }
+        filter.value = radius;
+        return SUCCESS;
+    }
+    else if(filter.name == "gauss" && parseDouble(value, filter.value)) {
+        if(filter.value <= 0 || filter.value > ConvolutionKernel::MAX_RADIUS / 3) {
+            std::cerr << "Improper value of standard deviation.\n";
+            return FAIL;
+        }
+        return SUCCESS;
+    }
+    else if(filter.name == "sharpen" && parseDouble(value, filter.value)) {
+        if(filter.value <= 0) {
+            std::cerr << "Improper value of amount.\n";
+            return FAIL;
+        }
+        return SUCCESS;
+    }
+    else if(filter.name == "kernel" && !value.empty()) {
+        std::size_t begin = 0;
+        filter.weights.clear();
+        while(begin <= value.size()) {
+            std::size_t end = std::min(value.find(',', begin), value.size());
+            double weight;
+            if(!parseDouble(value.substr(begin, end - begin), weight)) {
+                std::cerr << "Improper weight of kernel.\n";
+                return FAIL;
+            }
+            filter.weights.push_back(weight);
+            begin = end + 1;
+        }
+        if(!ConvolutionKernel::isSquare(filter.weights.size())) {
+            std::cerr << "Error. Kernel needs a square of an odd number of weights.\n";
+            return FAIL;
+        }
+        return SUCCESS;
+    }
+    std::cerr << "Error. Unknown filter " << text << ".\n";
+    return FAIL;
+}
+
+
+/**
+ * @brief Build kernel of a convolution filter
+ * @param filter parsed gauss, sharpen or kernel filter
+ * @return Kernel of the filter
+ */
+static ConvolutionKernel makeKernel(const Filter &filter) {
+    if(filter.name == "gauss") {
+        return ConvolutionKernel::gaussian(filter.value);
+    }
+    if(filter.name == "sharpen") {
+        return ConvolutionKernel::sharpen(filter.value);
+    }
+    return ConvolutionKernel::custom(filter.weights);
+}
+
+
+/**
+ * @brief Record one filter in the pipeline of an image
+ * @param img processed image
+ * @param pipeline pipeline of the image
+ * @param filter parsed filter
+ * @return Boolean value - whether the filter can be used on the image or not
+ */
+static bool applyFilter(Image &img, Pipeline &pipeline, const Filter &filter) {
+    const std::string &name = filter.name;
+
+    // filter is recorded for every colour with its own parameter, value to value filters are still applied in one sweep
+    if(!filter.values.empty()) {
+        int selected = img.getColour();
+        if(img.getType() != 3) {
+            std::cerr << "Error. Current image is not colorful.\n";
+            return FAIL;
+        }
+        for(int c = 0; c < 3; ++c) {
+            img.setColour(c);
+            applyFilter(img, pipeline, {name, filter.values[c], {}, {}});
+        }
+        img.setColour(selected);
+        return SUCCESS;
+    }
+    if(name == "colour") {
+        if(img.getType() != 3) {
+            std::cerr << "Error. Current image is not colorful.\n";
+            return FAIL;
+        }
+        img.setColour(int(filter.value));
+    }
+    else if(name == "grey") {
+        pipeline.flush();
+        return img.conversion2grey(Image::GreyWeights(filter.value));
+    }
+    else if(name == "negative") {
+        pipeline.negative();
+    }
+    else if(name == "contour") {
+        pipeline.gradient(Image::GradientOperator(filter.value), filter.norm);
+    }
+    else if(name == "stretch") {
+        pipeline.histogramStretching();
+    }
+    else if(name == "equalize") {
+        pipeline.histogramEqualization();
+    }
+    else if(name == "clip") {
+        pipeline.percentileStretching(filter.value);
+    }
+    else if(name == "threshold") {
+        pipeline.thresholding(filter.value);
+    }
+    else if(name == "black") {
+        pipeline.halfThresholdingBlack(filter.value);
+    }
+    else if(name == "white") {
+        pipeline.halfThresholdingWhite(filter.value);
+    }
+    else if(name == "gamma") {
+        pipeline.gammaCorrection(filter.value);
+    }
+    else if(name == "level") {
+        pipeline.levelAdjustment(filter.value);
+    }
+    else if(name == "hblur") {
+        pipeline.horizontalBlurring(int(filter.value));
+    }
+    else if(name == "vblur") {
+        pipeline.verticalBlurring(int(filter.value));
+    }
+    else if(name == "median") {
+        pipeline.medianFiltering(int(filter.value));
+    }
+    else if(name == "gauss" || name == "sharpen" || name == "kernel") {
+        pipeline.convolution(makeKernel(filter));
+    }
+    else {
+        pipeline.fullBlurring(int(filter.value));
+    }
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Apply filters to a loaded image
+ * @param img processed image
+ * @param filters filters applied in given order
+ * @param first index of the first filter that is applied, filters before it were applied while the image was loaded
+ * @return Boolean value - whether the operation was successful or not
+ */
+static bool applyFilters(Image &img, const std::vector<Filter> &filters, std::size_t first = 0) {
+    Pipeline pipeline(img);
+
+    for(std::size_t k = first; k < filters.size(); ++k) {
+        if(!applyFilter(img, pipeline, filters[k])) {
+            return FAIL;
+        }
+    }
+    pipeline.flush();
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Count halo rows that filters need above and below a band, so that the band is computed exactly as in the whole image
+ * @param filters filters applied in given order
+ * @param above number of rows above a band
+ * @param below number of rows below a band
+ * @return Boolean value - whether the filters can be applied band by band or not
+ */
+static bool countHalo(const std::vector<Filter> &filters, int &above, int &below) {
+    // radii are not limited by height of the image, so rows are counted in 64 bits and saturated,
+    // a halo higher than the image holds the whole image anyway
+    long long rows_above = 0;
+    long long rows_below = 0;
+
+    // rows that are wrong at the edges of a band spread further with every neighbourhood filter
+    for(const Filter &filter : filters) {
+        if(filter.name == "stretch" || filter.name == "equalize" || filter.name == "clip") {
+            std::cerr << "Error. Histogram filters need the whole image, they can not be streamed.\n";
+            return FAIL;
+        }
+        if(filter.name == "contour") {
+            // differences of neighbours read only the row below
+            rows_above += (filter.value != Image::DIFFERENCES ? 1 : 0);
+            rows_below += 1;
+        }
+        if(filter.name == "hblur") {
+            // the last row of a band is left unchanged, as the last row of the image is
+            rows_below += 1;
+        }
+        if(filter.name == "vblur" || filter.name == "blur" || filter.name == "median") {
+            rows_above += int(filter.value);
+            rows_below += int(filter.value);
+        }
+        if(filter.name == "gauss" || filter.name == "sharpen" || filter.name == "kernel") {
+            rows_above += makeKernel(filter).getRadius();
+            rows_below += makeKernel(filter).getRadius();
+        }
+    }
+    above = int(std::min<long long>(rows_above, INT_MAX));
+    below = int(std::min<long long>(rows_below, INT_MAX));
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Load an image, apply filters and save it, the image is streamed in bands when band_rows is set
+ * @param input path to image that is processed
+ * @param output path to which processed image is saved
+ * @param settings filters and options of saving
+ * @param pixels number of pixels of the image
+ * @param sequential whether small images are processed by calling thread only
+ * @return Boolean value - whether the operation was successful or not
+ */
+static bool processFile(const std::string &input, const std::string &output, const Settings &settings, long long &pixels, bool sequential) {
+    if(settings.band_rows > 0) {
+        int above;
+        int below;
+        if(!countHalo(settings.filters, above, below)) {
+            return FAIL;
+        }
+        Stream stream(settings.band_rows, above, below);
+        bool streamed = stream.run(input, output, settings.binary, [&](Image &band) { return applyFilters(band, settings.filters); });
+        pixels = stream.getPixels();
+        return streamed;
+    }
+
+    // conversion to grey that comes first is done while the image is decoded, so colour planes are never allocated
+    Image img;
+    std::size_t first = 0;
+    if(!settings.filters.empty() && settings.filters[0].name == "grey") {
+        first = 1;
+        if(!img.loadGreyFile(input, Image::GreyWeights(settings.filters[0].value))) {
+            return FAIL;
+        }
+    }
+    else if(!img.loadFile(input)) {
+        return FAIL;
+    }
+    pixels = static_cast<long long>(img.getWidth()) * img.getHeight();
+
+    if(sequential && pixels < BATCH_LARGE) {
+        ThreadPool::Sequential one_thread;
+        return applyFilters(img, settings.filters, first) && img.saveFile(output, settings.binary);
+    }
+    // large image shares the pool with images processed by other threads, it falls back to one thread when the pool is busy
+    return applyFilters(img, settings.filters, first) && img.saveFile(output, settings.binary);
+}
+
+
+/**
+ * @brief Process every image given by a directory or a pattern in parallel and report throughput
+ * @param source directory or pattern of images
+ * @param directory directory to which processed images are saved under their names, it is created if needed
+ * @param settings filters and options of saving
+ * @return Exit code of the program - 0 when all images were processed, 1 otherwise
+ */
+static int runBatch(const std::string &source, const std::string &directory, const Settings &settings) {
+    std::vector<std::string> files;
+    std::error_code error;
+
+    if(!Batch::collect(source, files)) {
+        return 1;
+    }
+    std::filesystem::create_directories(directory, error);
+    if(!std::filesystem::is_directory(directory, error)) {
+        std::cerr << "Error. Could not create directory " << directory << ".\n";
+        return 1;
+    }
+
+    Batch batch(files);
+    batch.run(ThreadPool::instance().getThreads(), [&](const std::string &file, BatchResult &result) {
+        std::filesystem::path output = std::filesystem::path(directory) / std::filesystem::path(file).filename();
+        return processFile(file, output.string(), settings, result.pixels, true);
+    });
+    batch.report(std::cout);
+
+    return batch.failures() == 0 ? 0 : 1;
+}
+
+
+int runCommandLine(int argc, char *argv[]) {
+    std::string input;
+    std::string output;
+    std::string source;
+    std::vector<std::string> texts;
+    Settings settings;
+
+    for(int k = 1; k < argc; ++k) {
+        std::string argument = argv[k];
+        bool has_value = (k + 1 < argc);
+
+        if(argument == "-i" && has_value) {
+            input = argv[++k];
+        }
+        else if(argument == "-o" && has_value) {
+            output = argv[++k];
+        }
+        else if(argument == "-b" && has_value) {
+            source = argv[++k];
+        }
+        else if(argument == "-s" && has_value) {
+            if(!readScript(argv[++k], texts)) {
+                return 1;
+            }
+        }
+        else if(argument == "-j" && has_value) {
+            int threads;
+            if(!parseInteger(argv[++k], threads) || threads <= 0) {
+                std::cerr << "Improper number of threads.\n";
+                return 1;
+            }
+            ThreadPool::instance().setThreads(threads);
+        }
+        else if(argument == "-m" && has_value) {
+            if(!parseInteger(argv[++k], settings.band_rows) || settings.band_rows <= 0) {
+                std::cerr << "Improper number of rows.\n";
+                return 1;
+            }
+        }
+        else if(argument == "-t") {
+            settings.binary = false;
+        }
+        else if(argument == "-h" || argument == "--help") {
+            printUsage();
+            return 0;
+        }
+        else if(argument[0] == '-') {
+            printUsage();
+            return 1;
+        }
+        else {
+            texts.push_back(argument);
+        }
+    }
+
+    if(input.empty() == source.empty() || output.empty()) {
+        printUsage();
+        return 1;
+    }
+    for(const std::string &text : texts) {
+        settings.filters.emplace_back();
+        if(!parseFilter(text, settings.filters.back())) {
+            return 1;
+        }
+    }
+
+    if(!source.empty()) {
+        return runBatch(source, output, settings);
+    }
+
+    long long pixels;
+    return processFile(input, output, settings, pixels, false) ? 0 : 1;
+}
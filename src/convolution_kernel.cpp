@@ -0,0 +1,133 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/convolution_kernel.hh"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+
+// weights differing from the product of a column and a row by so small part of the greatest weight are treated as equal
+#define SEPARABLE_TOLERANCE 1e-6
+
+
+ConvolutionKernel::ConvolutionKernel(int size, std::vector<double> weights) : size(size), weights(std::move(weights)) {
+}
+
+
+ConvolutionKernel ConvolutionKernel::gaussian(double sigma) {
+    int radius = std::min(int(std::ceil(3 * sigma)), MAX_RADIUS);
+    int size = 2 * radius + 1;
+    std::vector<double> line(size);
+    std::vector<double> weights(std::size_t(size) * size);
+    double sum = 0;
+
+    for(int k = 0; k < size; ++k) {
+        line[k] = std::exp(-double(k - radius) * (k - radius) / (2 * sigma * sigma));
+        sum += line[k];
+    }
+    for(int i = 0; i < size; ++i) {
+        for(int j = 0; j < size; ++j) {
+            weights[std::size_t(i) * size + j] = line[i] * line[j] / (sum * sum);
+        }
+    }
+    return ConvolutionKernel(size, std::move(weights));
+}
+
+
+ConvolutionKernel ConvolutionKernel::sharpen(double amount) {
+    return ConvolutionKernel(3, {0, -amount, 0, -amount, 1 + 4 * amount, -amount, 0, -amount, 0});
+}
+
+
+ConvolutionKernel ConvolutionKernel::custom(std::vector<double> weights) {
+    int size = int(std::lround(std::sqrt(double(weights.size()))));
+    double sum = 0;
+
+    for(double weight : weights) {
+        sum += weight;
+    }
+    if(sum != 0) {
+        for(double &weight : weights) {
+            weight /= sum;
+        }
+    }
+    return ConvolutionKernel(size, std::move(weights));
+}
+
+
+bool ConvolutionKernel::isSquare(std::size_t count) {
+    std::size_t size = std::size_t(std::lround(std::sqrt(double(count))));
+    return size * size == count && size % 2 == 1 && size <= 2 * MAX_RADIUS + 1;
+}
+
+
+int ConvolutionKernel::getSize() const {
+    return this->size;
+}
+
+
+int ConvolutionKernel::getRadius() const {
+    return this->size / 2;
+}
+
+
+std::vector<float> ConvolutionKernel::row(int i) const {
+    return std::vector<float>(this->weights.begin() + std::size_t(i) * this->size, this->weights.begin() + std::size_t(i + 1) * this->size);
+}
+
+
+bool ConvolutionKernel::separate(std::vector<float> &vertical, std::vector<float> &horizontal) const {
+    std::size_t pivot = 0;
+
+    // the greatest weight gives the most exact column and row
+    for(std::size_t k = 1; k < this->weights.size(); ++k) {
+        if(std::fabs(this->weights[k]) > std::fabs(this->weights[pivot])) {
+            pivot = k;
+        }
+    }
+    double greatest = this->weights[pivot];
+    if(greatest == 0) {
+        return false;
+    }
+    int p = int(pivot) / this->size;
+    int q = int(pivot) % this->size;
+
+    // kernel is separable when every weight is (weight in column q) * (weight in row p) / greatest
+    for(int i = 0; i < this->size; ++i) {
+        for(int j = 0; j < this->size; ++j) {
+            double product = this->weights[std::size_t(i) * this->size + q] * this->weights[std::size_t(p) * this->size + j] / greatest;
+            if(std::fabs(this->weights[std::size_t(i) * this->size + j] - product) > SEPARABLE_TOLERANCE * std::fabs(greatest)) {
+                return false;
+            }
+        }
+    }
+
+    vertical.resize(this->size);
+    horizontal.resize(this->size);
+    for(int k = 0; k < this->size; ++k) {
+        vertical[k] = float(this->weights[std::size_t(k) * this->size + q]);
+        horizontal[k] = float(this->weights[std::size_t(p) * this->size + k] / greatest);
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/histogram.hh"
+#include "../inc/lut.hh"
+#include <algorithm>
+#include <cmath>
+
+
+Histogram::Histogram(int depth) : depth(depth), counts(depth + 1, 0) {
+}
+
+
+void Histogram::merge(const Histogram &other) {
+    for(int value = 0; value <= this->depth; ++value) {
+        this->counts[value] += other.counts[value];
+    }
+    this->total += other.total;
+}
+
+
+Histogram Histogram::map(const Lut &lut) const {
+    Histogram mapped(this->depth);
+
+    for(int value = 0; value <= this->depth; ++value) {
+        mapped.counts[lut[value]] += this->counts[value];
+    }
+    mapped.total = this->total;
+    return mapped;
+}
+
+
+int Histogram::min() const {
+    for(int value = 0; value <= this->depth; ++value) {
+        if(this->counts[value] > 0) {
+            return value;
+        }
+    }
+    return this->depth;
+}
+
+
+int Histogram::max() const {
+    for(int value = this->depth; value >= 0; --value) {
+        if(this->counts[value] > 0) {
+            return value;
+        }
+    }
+    return 0;
+}
+
+
+int Histogram::percentile(double fraction) const {
+    // at least one sample has to be covered, so that fraction 0 gives the lowest value present
+    std::uint64_t needed = std::max<std::uint64_t>(std::ceil(std::clamp(fraction, 0.0, 1.0) * this->total), 1);
+    std::uint64_t covered = 0;
+
+    for(int value = 0; value <= this->depth; ++value) {
+        covered += this->counts[value];
+        if(covered >= needed) {
+            return value;
+        }
+    }
+    return this->depth;
+}
@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/history.hh"
+#include <utility>
+
+
+#define FAIL false;
+#define SUCCESS true;
+
+
+/**
+ * @brief Put a state on top of a stack of states, summed-area tables are kept only by the state on top,
+ *        so memory of tables does not grow with length of the history
+ * @param states stack of states, the top is at the back
+ * @param state state that is put on top
+ */
+template <typename Stack>
+static void push(Stack &states, Pipeline::Snapshot &&state) {
+    if(!states.empty()) {
+        states.back().releaseSummedAreas();
+    }
+    states.push_back(std::move(state));
+}
+
+
+History::History(Pipeline &pipeline, std::size_t limit) : pipeline(pipeline), limit(limit) {
+}
+
+
+void History::checkpoint() {
+    push(this->past, this->pipeline.snapshot());
+    if(this->past.size() > this->limit) {
+        this->past.pop_front();
+    }
+    this->future.clear();
+}
+
+
+bool History::undo() {
+    if(this->past.empty()) {
+        return FAIL;
+    }
+    push(this->future, this->pipeline.snapshot());
+    this->pipeline.restore(std::move(this->past.back()));
+    this->past.pop_back();
+    return SUCCESS;
+}
+
+
+bool History::redo() {
+    if(this->future.empty()) {
+        return FAIL;
+    }
+    push(this->past, this->pipeline.snapshot());
+    this->pipeline.restore(std::move(this->future.back()));
+    this->future.pop_back();
+    return SUCCESS;
+}
+
+
+void History::clear() {
+    this->past.clear();
+    this->future.clear();
+}
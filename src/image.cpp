@@ -22,178 +22,463 @@ SOFTWARE.
 
 
 #include "../inc/image.hh"
-#include <ios>
+#include "../inc/convolution_kernel.hh"
+#include "../inc/histogram.hh"
+#include "../inc/lut.hh"
+#include "../inc/netpbm.hh"
+#include "../inc/plane_pool.hh"
+#include "../inc/scratch.hh"
+#include "../inc/simd.hh"
+#include "../inc/summed_area.hh"
+#include "../inc/thread_pool.hh"
+#include "../inc/trace.hh"
+#include <algorithm>
+#include <cerrno>
 #include <cmath>
-#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 
 #define FAIL false;
 #define SUCCESS true;
 
 
-Image::Image(const Image & img) {
-    this->width = img.width;
-    this->height = img.height;
-    this->depth = img.depth;
-    this->img_type = img.img_type;
-    this->colour = img.colour;
-    this->pixels = img.pixels;
+// every row starts on a 64 byte boundary(one cache line)
+#define ALIGNMENT 64
+// running sums of columns of one strip take at most so many bytes
+#define STRIP_BYTES 16384
+// rows of a colour image decoded at once when it is loaded as grey
+#define GREY_CHUNK_ROWS 16
+// histograms of columns of one strip of median filter and of its window take at most so many bytes, unless the strip
+// would be narrower than the window(16-bit columns take 64 KiB each, so 16-bit images with radius above 3 exceed it)
+#define MEDIAN_STRIP_BYTES (1 << 20)
+// summed-area tables take 8 bytes per sample, they are not built for bigger planes
+#define SUMMED_AREA_LIMIT (std::size_t(1) << 26)
+// bigger images are reduced before they are displayed
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+
+
+std::shared_ptr<unsigned char> Image::allocatePlane() const {
+    std::size_t bytes = this->planeSize() * this->sample_size;
+    std::shared_ptr<unsigned char> memory = PlanePool::instance().take(bytes);
+
+    if(memory) {
+        // lookup tables are applied to whole rows, so padding must not keep samples of an image of greater depth
+        std::size_t row = std::size_t(this->stride) * this->sample_size;
+        std::size_t samples = std::size_t(this->width) * this->sample_size;
+        for(int i = 0; i < this->height && samples < row; ++i) {
+            std::memset(memory.get() + i * row + samples, 0, row - samples);
+        }
+        return memory;
+    }
+
+    TRACE_COUNT(TRACE_ALLOCATIONS, 1);
+    memory = PlanePool::instance().allocate(bytes, ALIGNMENT);
+    // padding at the end of rows is never processed, but it should not be left uninitialised
+    std::memset(memory.get(), 0, bytes);
+    return memory;
 }
 
 
-Image::~Image() {
-    if(this->pixels) {
-        for(int c = 0; c < this->img_type; ++c) {
-            for(int i = 0; i < this->height; ++i) {
-                delete [] this->pixels[c][i];
+void Image::forget(int c) {
+    this->histograms[c].reset();
+    // table may be shared with copies of the image that still have the old plane
+    if(!this->areas[c] || this->areas[c].use_count() > 1) {
+        this->areas[c] = std::make_shared<std::shared_ptr<const SummedArea>>();
+    }
+    else {
+        this->areas[c]->reset();
+    }
+}
+
+
+void Image::detach(int c) {
+    this->forget(c);
+    // plane is shared with a snapshot or a copy of the image, so it is copied before it is changed
+    if(this->planes[c].use_count() > 1) {
+        std::shared_ptr<unsigned char> copy = this->allocatePlane();
+        std::memcpy(copy.get(), this->planes[c].get(), this->planeSize() * this->sample_size);
+        this->planes[c] = copy;
+    }
+}
+
+
+void Image::detachColours() {
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        this->detach(c);
+    }
+}
+
+
+int Image::firstColour() const {
+    return (this->colour == ALL_COLOURS ? 0 : this->colour);
+}
+
+
+int Image::lastColour() const {
+    return (this->colour == ALL_COLOURS ? this->img_type : this->colour + 1);
+}
+
+
+void Image::replace(int c, std::shared_ptr<unsigned char> plane) {
+    this->planes[c] = plane;
+    this->forget(c);
+}
+
+
+void Image::countHistograms(int first, int last) const {
+    TRACE_SPAN("Image::countHistograms");
+    std::vector<int> missing;
+    std::mutex merging;
+
+    for(int c = first; c < last; ++c) {
+        if(!this->histograms[c]) {
+            missing.push_back(c);
+        }
+    }
+    if(missing.empty()) {
+        return;
+    }
+
+    std::vector<Histogram> merged(missing.size(), Histogram(this->depth));
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+
+        // every band counts its own histograms, so that threads do not share counters, then they are merged
+        ThreadPool::instance().parallelFor(0, this->height, [&](int top, int bottom) {
+            std::vector<Histogram> band(missing.size(), Histogram(this->depth));
+            for(int i = top; i < bottom; ++i) {
+                for(std::size_t m = 0; m < missing.size(); ++m) {
+                    band[m].count(this->row<T>(missing[m], i), this->width);
+                }
+            }
+            std::lock_guard<std::mutex> lock(merging);
+            for(std::size_t m = 0; m < missing.size(); ++m) {
+                merged[m].merge(band[m]);
             }
-            delete [] this->pixels[c];
+        });
+    });
+
+    for(std::size_t m = 0; m < missing.size(); ++m) {
+        this->histograms[missing[m]] = std::make_shared<const Histogram>(std::move(merged[m]));
+    }
+}
+
+
+std::size_t Image::planeSize() const {
+    return std::size_t(this->height) * this->stride;
+}
+
+
+Image::Image(Image &&img) noexcept {
+    *this = std::move(img);
+}
+
+
+Image &Image::operator=(Image &&img) noexcept {
+    if(this != &img) {
+        this->width = std::exchange(img.width, 0);
+        this->height = std::exchange(img.height, 0);
+        this->depth = std::exchange(img.depth, 0);
+        this->img_type = std::exchange(img.img_type, 0);
+        this->colour = std::exchange(img.colour, 0);
+        this->sample_size = std::exchange(img.sample_size, 1);
+        this->stride = std::exchange(img.stride, 0);
+        for(int c = 0; c < 3; ++c) {
+            this->planes[c] = std::move(img.planes[c]);
+            this->histograms[c] = std::move(img.histograms[c]);
+            this->areas[c] = std::move(img.areas[c]);
         }
-        delete [] this->pixels;
     }
+    return *this;
 }
 
 
 bool Image::load(std::string img_title) {
-    std::string magic_number;
-    std::string comment;
-    std::ifstream source;
     std::string file_name;
 
     file_name.append("pic/");
     file_name.append(img_title);
 
-    source.open(file_name);
-    if(!source.good()) {
-        std::cerr << "Error. Could not load an image.\n";
+    return this->loadFile(file_name);
+}
+
+
+bool Image::loadFile(std::string file_name) {
+    TRACE_SPAN("Image::loadFile");
+    NetpbmReader source;
+
+    // check whether input image is saved in pgm or ppm format or not, then load its header
+    if(!source.open(file_name)) {
         return FAIL;
     }
 
-    // check whether input image is saved in pgm or ppm format or not
-    getline(source, magic_number);
-    if(magic_number[0] != 'P' || (magic_number[1] != '2' && magic_number[1] != '3')) {
-        std::cerr << "Error. This is neither PGM nor PPM image.\n";
+    this->create(source.getType(), source.getWidth(), source.getHeight(), source.getDepth());
+
+    // load pixels for every colour
+    bool loaded = this->readRows(source, 0, this->height);
+    source.close();
+
+    if(!loaded) {
+        for(int c = 0; c < 3; ++c) {
+            this->replace(c, nullptr);
+        }
         return FAIL;
     }
 
-    // load "magic number"
-    if(magic_number[1] == '2') {
-        this->img_type = 1;
+    return SUCCESS;
+}
+
+
+bool Image::loadGreyFile(std::string file_name, GreyWeights weights) {
+    TRACE_SPAN("Image::loadGreyFile");
+    NetpbmReader source;
+    Image chunk;
+
+    if(!source.open(file_name)) {
+        return FAIL;
     }
-    if(magic_number[1] == '3') {
-        this->img_type = 3;
+    if(source.getType() == 1) {
+        source.close();
+        return this->loadFile(file_name);
     }
 
-    this->colour = 0;
+    // colour rows are decoded into a small chunk that stays in cache and converted right away,
+    // so colour planes of the whole image are never allocated
+    this->create(1, source.getWidth(), source.getHeight(), source.getDepth());
+    chunk.create(3, this->width, std::min(GREY_CHUNK_ROWS, this->height), this->depth);
+
+    bool loaded = true;
+    for(int first = 0; loaded && first < this->height; first += chunk.height) {
+        int rows = std::min(chunk.height, this->height - first);
+        loaded = chunk.readRows(source, 0, rows);
+        this->dispatch([&](auto sample) {
+            using T = decltype(sample);
+            greySpan(chunk.row<T>(0, 0), chunk.row<T>(1, 0), chunk.row<T>(2, 0), this->row<T>(0, first), std::size_t(rows) * this->stride, weights);
+        });
+    }
+    source.close();
 
-    // ignore comments
-    int len = source.tellg();
-    std::getline(source, comment);
-    if(comment[0] == '#') {
-        while(comment[0] == '#') {
-            len = source.tellg();
-            std::getline(source, comment);
-        }
-        // return to position before "getline".
-        source.seekg(len, std::ios_base::beg);
+    if(!loaded) {
+        this->replace(0, nullptr);
+        return FAIL;
     }
-    else {
-        // return to position before "getline".
-        source.seekg(len, std::ios_base::beg);
+    return SUCCESS;
+}
+
+
+void Image::create(int img_type, int width, int height, int depth) {
+    this->img_type = img_type;
+    this->width = width;
+    this->height = height;
+    this->depth = depth;
+    this->colour = 0;
+
+    // the narrowest sample type that can hold the depth
+    this->sample_size = (this->depth <= 255 ? 1 : 2);
+
+    // allocate one block of memory for all planes, rows are padded to full cache lines
+    int per_line = ALIGNMENT / this->sample_size;
+    this->stride = (this->width + per_line - 1) / per_line * per_line;
+    for(int c = 0; c < 3; ++c) {
+        this->replace(c, c < this->img_type ? this->allocatePlane() : nullptr);
     }
+}
 
-    // load image width, height and depth
-    source >> this->width;
-    source >> this->height;
-    source >> this->depth;
 
-    // allocate memory space
-    this->pixels = new int **[this->img_type];
-    for(int c = 0; c < this->img_type; ++c) {
-        pixels[c] = new int *[this->height];
-        for(int i = 0; i < this->height; ++i) {
-            pixels[c][i] = new int[this->width];
+bool Image::readRows(NetpbmReader &source, int first, int rows) {
+    bool loaded = false;
+
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+        T *planes[3];
+        for(int c = 0; c < this->img_type; ++c) {
+            this->detach(c);
+            planes[c] = this->row<T>(c, first);
         }
-    }
+        loaded = source.readRows(rows, planes, this->stride);
+    });
+    return loaded;
+}
 
-    // load pixels for every colour
-    for(int i = 0; i < this->height; ++i) {
-        for(int j = 0; j < this->width; ++j) {
-            for(int c = 0; c < this->img_type; ++c) {
-                source >> pixels[c][i][j];
-            }
+
+bool Image::writeRows(NetpbmWriter &file, int first, int rows) const {
+    bool saved = false;
+
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+        const T *planes[3];
+        for(int c = 0; c < this->img_type; ++c) {
+            planes[c] = this->row<T>(c, first);
         }
-    }
-    source.close();
+        saved = file.writeRows(rows, planes, this->stride);
+    });
+    return saved;
+}
 
-    return SUCCESS;
+
+void Image::copyRows(const Image &source, int from, int to, int rows) {
+    std::size_t bytes = std::size_t(rows) * this->stride * this->sample_size;
+
+    // source and destination may overlap when rows are moved within one image
+    for(int c = 0; c < this->img_type; ++c) {
+        this->detach(c);
+        std::memmove(this->planes[c].get() + std::size_t(to) * this->stride * this->sample_size,
+                     source.planes[c].get() + std::size_t(from) * source.stride * source.sample_size, bytes);
+    }
 }
 
 
-bool Image::save(std::string img_title) {
-    std::string magic_num;
-    std::ofstream file;
+bool Image::save(std::string img_title, bool binary) {
     std::string file_name;
 
     file_name.append("pic/");
     file_name.append(img_title);
 
     if(this->img_type == 1) {
-        magic_num = "P2";
         file_name.append(".pgm");
     }
 
     if(this->img_type == 3) {
-        magic_num = "P3";
         file_name.append(".ppm");
     }
 
-    file.open(file_name);
-    if(!file.good()) {
-        std::cerr << "Error. Could not save an image.\n";
-        return FAIL;
-    }
+    return this->saveFile(file_name, binary);
+}
+
+
+bool Image::saveFile(std::string file_name, bool binary) {
+    TRACE_SPAN("Image::saveFile");
+    NetpbmWriter file;
 
     // write "magic number", width, height and depth
-    file << magic_num << "\n";
-    file << this->width << " " << this->height << " " << this->depth << "\n";
+    if(!file.open(file_name, this->img_type, this->width, this->height, this->depth, binary)) {
+        return FAIL;
+    }
 
     // write pixels of every colour
-    for(int i = 0; i < this->height; ++i) {
-        for(int j = 0; j < this->width; ++j) {
-            for(int c = 0; c < this->img_type; ++c) {
-                file << this->pixels[c][i][j] << " ";
-            }
-        }
-        file << "\n";
-    }
-    file.close();
+    bool saved = this->writeRows(file, 0, this->height);
 
-    return SUCCESS;
+    return saved && file.close();
 }
 
 
-void Image::display() {
-    // save changes to temporary file, display an image and then remove temporary file
-    std::string tmp = "temporary";
-    std::string display_order = "";
-    std::string remove_order = "";
+bool Image::display() const {
+    TRACE_SPAN("Image::display");
+    int screen_width = SCREEN_WIDTH;
+    int screen_height = SCREEN_HEIGHT;
+    std::string viewer = "display";
 
-    this->save(tmp); 
-    if(this->img_type == 1) {
-        tmp.append(".pgm");
+    // size of the screen and the viewer can be changed e.g. IMAGE_SCREEN=3840x2160 IMAGE_VIEWER=feh
+    const char *screen = std::getenv("IMAGE_SCREEN");
+    if(screen && (std::sscanf(screen, "%dx%d", &screen_width, &screen_height) != 2 || screen_width <= 0 || screen_height <= 0)) {
+        screen_width = SCREEN_WIDTH;
+        screen_height = SCREEN_HEIGHT;
     }
-    if(this->img_type == 3) {
-        tmp.append(".ppm");
-    }  
+    if(std::getenv("IMAGE_VIEWER")) {
+        viewer = std::getenv("IMAGE_VIEWER");
+    }
+
+    // image bigger than the screen is reduced by the smallest factor that makes it fit, otherwise its planes are shared
+    int factor = std::max((this->width + screen_width - 1) / screen_width, (this->height + screen_height - 1) / screen_height);
+    Image preview = (factor > 1 ? this->shrink(factor) : *this);
+
+    // viewer reads the image from its standard input, write end of the pipe is not inherited so that it sees end of file
+    int channel[2];
+    if(pipe2(channel, O_CLOEXEC) != 0) {
+        std::cerr << "Error. Could not display an image.\n";
+        return FAIL;
+    }
+
+    std::string stdin_name = "-";
+    char *arguments[] = {viewer.data(), stdin_name.data(), nullptr};
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, channel[0], STDIN_FILENO);
+    pid_t viewer_pid;
+    int spawned = posix_spawnp(&viewer_pid, viewer.c_str(), &actions, nullptr, arguments, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(channel[0]);
+
+    if(spawned != 0) {
+        close(channel[1]);
+        std::cerr << "Error. Could not run image viewer " << viewer << ".\n";
+        return FAIL;
+    }
+
+    // viewer closed before it read the whole image must not kill the program
+    struct sigaction ignore = {};
+    struct sigaction previous;
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, &previous);
+
+    NetpbmWriter file;
+    bool sent = file.attach(channel[1], preview.img_type, preview.width, preview.height, preview.depth)
+             && preview.writeRows(file, 0, preview.height);
+    sent = file.close() && sent;
+
+    sigaction(SIGPIPE, &previous, nullptr);
 
-    display_order.append("display pic/");
-    display_order.append(tmp);
-    system(display_order.c_str());
+    int status = 0;
+    while(waitpid(viewer_pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    return sent;
+}
+
+
+Image Image::shrink(int factor) const {
+    TRACE_SPAN("Image::shrink");
+    Image preview;
 
-    remove_order.append("rm pic/");
-    remove_order.append(tmp);
-    system(remove_order.c_str());
+    preview.create(this->img_type, (this->width + factor - 1) / factor, (this->height + factor - 1) / factor, this->depth);
+    preview.colour = this->colour;
+
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+        ThreadPool::instance().parallelFor(0, preview.height, [&](int first, int last) {
+            // sums of blocks of one row of the preview
+            Scratch::Frame frame;
+            std::uint64_t *sums = frame.take<std::uint64_t>(preview.width, 0);
+            for(int c = 0; c < this->img_type; ++c) {
+                for(int i = first; i < last; ++i) {
+                    int top = i * factor;
+                    int rows = std::min(factor, this->height - top);
+                    std::fill(sums, sums + preview.width, 0);
+                    for(int k = top; k < top + rows; ++k) {
+                        const T *source = this->row<T>(c, k);
+                        for(int b = 0, j = 0; b < preview.width; ++b) {
+                            int end = std::min(j + factor, this->width);
+                            std::uint64_t sum = 0;
+                            for(; j < end; ++j) {
+                                sum += source[j];
+                            }
+                            sums[b] += sum;
+                        }
+                    }
+                    T *target = preview.row<T>(c, i);
+                    for(int b = 0; b < preview.width; ++b) {
+                        std::uint64_t area = std::uint64_t(rows) * std::min(factor, this->width - b * factor);
+                        target[b] = T((sums[b] + area / 2) / area);
+                    }
+                }
+            }
+        });
+    });
+    return preview;
 }
 
 
@@ -204,7 +489,7 @@ bool Image::selectColour() {
     if(this->img_type == 3) {     
         while(!selected) {
             std::cout << "\nSelect a colour to be processed:\n";
-            std::cout << "r - red\n" << "g - green\n" << "b - blue\n";
+            std::cout << "r - red\n" << "g - green\n" << "b - blue\n" << "a - all colours\n";
             std::cout << "\nYour selection: ";
             std::cin >> selection;
             std::cout << "\n";
@@ -228,6 +513,11 @@ bool Image::selectColour() {
                     std::cout << "You have selected blue.\n";
                     selected = true;
                     break;
+                case 'a':
+                    this->colour = ALL_COLOURS;
+                    std::cout << "You have selected all colours.\n";
+                    selected = true;
+                    break;
                 default:    // for wrong input
                     std::cin.clear();
                     std::cerr << "Error. Your selection does not match any of the available options.\n";
@@ -249,35 +539,111 @@ bool Image::selectColour() {
 }
 
 
-bool Image::conversion2grey() {
-    if(this->img_type == 3) {
-        int ***tmp;
-        tmp = new int **[1];
-        tmp[0] = new int *[this->height];
-        for(int i = 0; i < this->height; ++i) {
-            tmp[0][i] = new int[this->width];
-        }
-        for(int i = 0; i < this->height; ++i) {
-            for(int j = 0; j < this->width; ++j) {
-                int new_pixel = 0;
-                for(int c = 0; c < this->img_type; ++c) {
-                    new_pixel += this->pixels[c][i][j];
-                }
-                tmp[0][i][j] = new_pixel / 3;
-            }
-        }
+int Image::getColour() const {
+    return this->colour;
+}
+
+
+void Image::setColour(int c) {
+    this->colour = c;
+}
+
+
+int Image::getWidth() const {
+    return this->width;
+}
+
+
+int Image::getHeight() const {
+    return this->height;
+}
+
+
+int Image::getDepth() const {
+    return this->depth;
+}
+
+
+int Image::getType() const {
+    return this->img_type;
+}
+
+
+const SummedArea &Image::summedArea(int c) const {
+    if(!this->areas[c]) {
+        this->areas[c] = std::make_shared<std::shared_ptr<const SummedArea>>();
+    }
+    if(!*this->areas[c]) {
+        this->dispatch([&](auto sample) {
+            using T = decltype(sample);
+            *this->areas[c] = std::make_shared<const SummedArea>(SummedArea::build(this->plane<T>(c), this->stride, this->width, this->height));
+        });
+    }
+    return **this->areas[c];
+}
+
+
+void Image::releaseSummedAreas() {
+    for(int c = 0; c < 3; ++c) {
+        this->areas[c].reset();
+    }
+}
+
+
+const Histogram &Image::histogram(int c) const {
+    if(!this->histograms[c]) {
+        this->countHistograms(c, c + 1);
+    }
+    return *this->histograms[c];
+}
+
+
+/**
+ * @brief Convert samples of three colour spans to grey with given weights
+ * @param red pointer to the first red sample
+ * @param green pointer to the first green sample
+ * @param blue pointer to the first blue sample
+ * @param grey pointer to the first grey sample, it may be the same as red
+ * @param size number of samples
+ * @param weights weights of colours
+ */
+template <typename T>
+static void greySpan(const T *red, const T *green, const T *blue, T *grey, std::size_t size, Image::GreyWeights weights) {
+    // luma coefficients in units of 1/32768, every set sums up to 32768
+    switch(weights) {
+    case Image::BT601:
+        lumaSpan(red, green, blue, grey, size, 9798, 19235, 3735);
+        break;
+    case Image::BT709:
+        lumaSpan(red, green, blue, grey, size, 6966, 23436, 2366);
+        break;
+    default:
+        meanSpan(red, green, blue, grey, size);
+        break;
+    }
+}
 
-        for(int c = 0; c < this->img_type; ++c) {
-            for(int i = 0; i < this->height; ++i) {
-                delete [] this->pixels[c][i];
-            }
-            delete [] this->pixels[c];
-        }
-        delete [] this->pixels;
+
+bool Image::conversion2grey(GreyWeights weights) {
+    TRACE_SPAN("Image::conversion2grey");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    if(this->img_type == 3) {
+        // grey sample depends only on samples at the same position, so red plane is overwritten unless a snapshot uses it
+        std::shared_ptr<unsigned char> grey = (this->planes[0].use_count() > 1 ? this->allocatePlane() : this->planes[0]);
+        this->dispatch([&](auto sample) {
+            using T = decltype(sample);
+            ThreadPool::instance().parallelFor(0, this->height, [&](int first, int last) {
+                std::size_t offset = std::size_t(first) * this->stride;
+                greySpan(this->row<T>(0, first), this->row<T>(1, first), this->row<T>(2, first),
+                         reinterpret_cast<T *>(grey.get()) + offset, std::size_t(last - first) * this->stride, weights);
+            });
+        });
 
         this->img_type = 1;
         this->colour = 0;
-        this->pixels = tmp;
+        this->replace(0, grey);
+        this->replace(1, nullptr);
+        this->replace(2, nullptr);
     }
     else {
         std::cerr << "Error. Current image is not colorful.\n";
@@ -287,237 +653,778 @@ bool Image::conversion2grey() {
 }
 
 
+// Point filters split the plane into bands of rows, one band per thread.
+// Every band is walked as one flat span, padding samples included, by vectorized kernels where possible.
+// When all colours are selected, every band processes its rows of all planes, so the image is swept once.
+// Filters that are expensive to compute for every sample use lookup tables instead.
+
+
 void Image::negative() {
-    for(int i = 0; i < this->height; ++i) {
-        for(int j = 0; j < this->width; ++j) {
-            int current = this->pixels[this->colour][i][j];
-            this->pixels[this->colour][i][j] = this->depth - current;
-        }
-    }
+    TRACE_SPAN("Image::negative");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    this->detachColours();
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+        int depth = this->depth;
+
+        ThreadPool::instance().parallelFor(0, this->height, [&](int first, int last) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                negativeSpan(this->row<T>(c, first), std::size_t(last - first) * this->stride, depth);
+            }
+        });
+    });
 }
 
 
 void Image::thresholding(double threshold) {
+    TRACE_SPAN("Image::thresholding");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    this->detachColours();
     int limit = threshold * this->depth; 
 
-    for(int i = 0; i < this->height; ++i) {
-        for(int j = 0; j < this->width; ++j) {
-            int current = this->pixels[this->colour][i][j];
-            this->pixels[this->colour][i][j] = (current <= limit ? 0 : this->depth);
-        }
-    }
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+
+        ThreadPool::instance().parallelFor(0, this->height, [&](int first, int last) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                thresholdSpan(this->row<T>(c, first), std::size_t(last - first) * this->stride, limit, 0, this->depth);
+            }
+        });
+    });
 }
 
 
 void Image::halfThresholdingBlack(double threshold) {
+    TRACE_SPAN("Image::halfThresholdingBlack");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    this->detachColours();
     int limit = threshold * this->depth; 
 
-    for(int i = 0; i < this->height; ++i) {
-        for(int j = 0; j < this->width; ++j) {
-            int current = this->pixels[this->colour][i][j];
-            this->pixels[this->colour][i][j] = (current <= limit ? 0 : current);
-        }
-    }
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+
+        // -1 keeps samples above limit unchanged
+        ThreadPool::instance().parallelFor(0, this->height, [&](int first, int last) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                thresholdSpan(this->row<T>(c, first), std::size_t(last - first) * this->stride, limit, 0, -1);
+            }
+        });
+    });
 }
 
 
 void Image::halfThresholdingWhite(double threshold) {
+    TRACE_SPAN("Image::halfThresholdingWhite");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    this->detachColours();
     int limit = threshold * this->depth; 
 
-    for(int i = 0; i < this->height; ++i) {
-        for(int j = 0; j < this->width; ++j) {
-            int current = this->pixels[this->colour][i][j];
-            this->pixels[this->colour][i][j] = (current <= limit ? current : this->depth);
-        }
-    }
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+
+        // -1 keeps samples below limit unchanged
+        ThreadPool::instance().parallelFor(0, this->height, [&](int first, int last) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                thresholdSpan(this->row<T>(c, first), std::size_t(last - first) * this->stride, limit, -1, this->depth);
+            }
+        });
+    });
 }
 
 
 void Image::gammaCorrection(double gamma) {
-    for(int i = 0; i < this->height; ++i) {
-        for(int j = 0; j < this->width; ++j) {
-            int current = this->pixels[this->colour][i][j];
-            this->pixels[this->colour][i][j] = int(pow((double(current) / double(this->depth)), (1.0 / gamma)) * this->depth);
-        }
-     }
+    TRACE_SPAN("Image::gammaCorrection");
+    // pow is called once for every possible value, not for every pixel
+    this->transform(Lut::gamma(this->depth, gamma));
 }
 
 
 void Image::levelAdjustment(double level) {
+    TRACE_SPAN("Image::levelAdjustment");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    this->detachColours();
     int black = this->depth * level;
     int white = this->depth * (1 - level); 
 
-    for(int i = 0; i < this->height; ++i) {
-        for(int j = 0; j < this->width; ++j) {
-            int current = this->pixels[this->colour][i][j];
-            if(current <= black) {
-                this->pixels[this->colour][i][j] = 0;
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+
+        ThreadPool::instance().parallelFor(0, this->height, [&](int first, int last) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                levelSpan(this->row<T>(c, first), std::size_t(last - first) * this->stride, black, white, this->depth);
             }
-            else if(current < white) {
-                this->pixels[this->colour][i][j] = int(this->depth / (white - black) * (current - black));
+        });
+    });
+}
+
+
+void Image::transform(const Lut &lut) {
+    ColourTables tables = {};
+
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        tables[c] = &lut;
+    }
+    this->transform(tables);
+}
+
+
+void Image::transform(const ColourTables &tables) {
+    TRACE_SPAN("Image::transform");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    std::shared_ptr<const Histogram> mapped[3];
+
+    for(int c = 0; c < this->img_type; ++c) {
+        if(tables[c]) {
+            // histogram of mapped samples follows from the table, so it does not have to be counted again
+            if(this->histograms[c]) {
+                mapped[c] = std::make_shared<const Histogram>(this->histograms[c]->map(*tables[c]));
             }
-            else {
-                this->pixels[this->colour][i][j] = this->depth;
+            this->detach(c);
+        }
+    }
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+
+        ThreadPool::instance().parallelFor(0, this->height, [&](int first, int last) {
+            for(int c = 0; c < this->img_type; ++c) {
+                if(tables[c]) {
+                    tables[c]->apply(this->row<T>(c, first), std::size_t(last - first) * this->stride);
+                }
             }
+        });
+    });
+    for(int c = 0; c < this->img_type; ++c) {
+        if(tables[c]) {
+            this->histograms[c] = mapped[c];
         }
     }
 }
 
 
-void Image::contouring() {
-    for(int i = 0; i < this->height - 1; ++i) {
-        for(int j = 0; j < this->width - 1; ++j) {
-            int current = this->pixels[this->colour][i][j];
-            int val1 = abs(this->pixels[this->colour][i+1][j] - current);
-            int val2 = abs(this->pixels[this->colour][i][j+1] - current);
-            int val = val1 + val2;
-            this->pixels[this->colour][i][j] = (val <= this->depth ? val : this->depth);
+// Gradient is written to separate plane, so every row is computed from unchanged rows around it, bands need no halo copies
+// and the last row and column are computed as well, with the nearest pixels of the image beyond its edges.
+void Image::gradient(GradientOperator op, GradientNorm norm, const Lut *post) {
+    TRACE_SPAN("Image::gradient");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    // planes of the gradient replace current ones, which may still be used by snapshots
+    std::shared_ptr<unsigned char> tmp[3];
+
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+        for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+            tmp[c] = this->allocatePlane();
         }
+
+        ThreadPool::instance().parallelFor(0, this->height, [&](int first, int last) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                for(int i = first; i < last; ++i) {
+                    T *dst = reinterpret_cast<T *>(tmp[c].get()) + std::size_t(i) * this->stride;
+                    gradientSpan(this->row<T>(c, std::max(i - 1, 0)), this->row<T>(c, i), this->row<T>(c, std::min(i + 1, this->height - 1)),
+                                 dst, this->width, op, norm, this->depth);
+                    if(post) {
+                        post->apply(dst, this->stride);
+                    }
+                }
+            }
+        });
+    });
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        this->replace(c, tmp[c]);
     }
 }
 
 
-void Image::horizontalBlurring(int radius) {
-    int **tmp;
-    tmp = new int *[this->height];
-    for(int i = 0; i < this->height; ++i) {
-        tmp[i] = new int [this->width];
-        for(int j = 0; j < this->width; ++j) {
-            tmp[i][j] = this->pixels[this->colour][i][j];
+// Blurring filters keep running sums of the window, so cost of every pixel does not depend on radius.
+// Only neighbours that exist are counted at the borders, the last row and column are left unchanged.
+// Blurred rows are written to separate plane, so bands of rows need no halo copies.
+// Lookup table of point filters that follow a blur can be applied to every row while it is still in cache.
+// Vertical and full blurring walk every band in strips of columns, so that running sums of columns stay in L1 cache.
+// Planes that are kept by snapshots are blurred from their cached summed-area tables instead, four entries of a table per arm of the window.
+
+
+/**
+ * @brief Call function with a divider of window sums by number of samples in the window,
+ *        division is replaced by multiplication with reciprocal whenever quotient is exactly the same
+ * @param size number of samples in the window
+ * @param depth maximal value of a sample
+ * @param body function called with the divider
+ */
+template <typename Sum, typename Body>
+static inline void divideBy(Sum size, int depth, Body body) {
+    // floor(x / size) == (x * m) >> SHIFT for m = floor(2^SHIFT / size) + 1 whenever x * size < 2^SHIFT,
+    // x is at most depth * size, 32-bit reciprocal of 8-bit sums can be multiplied by vector instructions
+    constexpr int SHIFT = (sizeof(Sum) == 4 ? 32 : 40);
+    using Reciprocal = std::conditional_t<sizeof(Sum) == 4, std::uint32_t, std::uint64_t>;
+
+    if(size > 1 && size < 4096 && std::uint64_t(depth) * size * size < (std::uint64_t(1) << SHIFT)) {
+        Reciprocal m = Reciprocal((std::uint64_t(1) << SHIFT) / size + 1);
+        body([m](Sum x) { return Sum((std::uint64_t(x) * m) >> SHIFT); });
+    }
+    else {
+        body([size](Sum x) { return Sum(x / size); });
+    }
+}
+
+
+bool Image::keepsSummedArea() const {
+    if(this->planeSize() > SUMMED_AREA_LIMIT) {
+        return false;
+    }
+    // plane that is kept by a snapshot may be blurred again after undo, e.g. with another radius
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        if(!(this->areas[c] && *this->areas[c]) && this->planes[c].use_count() < 2) {
+            return false;
         }
     }
+    return true;
+}
 
-    for(int i = 0; i < this->height - 1; ++i) {
-        for(int j = 0; j < this->width - 1; ++j) {
-            int left = 0;
-            int right = 0;
-            int counter = 0;
-            for(int r = 1; r < radius + 1; ++r) {
-                if(j - r >= 0) {
-                    left += this->pixels[this->colour][i][j-r];
-                    counter++;
-                }
-                if(j + r <= this->width - 1) {
-                    right += this->pixels[this->colour][i][j+r];
-                    counter++;
+
+void Image::summedAreaBlurring(int horizontal, int vertical, const Lut *post) {
+    TRACE_SPAN("Image::summedAreaBlurring");
+    // blurred planes replace current ones, which may still be used by snapshots
+    std::shared_ptr<unsigned char> tmp[3];
+    std::size_t bytes = this->planeSize() * this->sample_size;
+    const SummedArea *tables[3] = {};
+
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        tables[c] = &this->summedArea(c);
+    }
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+        for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+            tmp[c] = this->allocatePlane();
+            std::memcpy(tmp[c].get(), this->plane<T>(c), bytes);
+        }
+
+        ThreadPool::instance().parallelFor(0, this->height - 1, [&](int first, int last) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                for(int i = first; i < last; ++i) {
+                    const T *src = this->row<T>(c, i);
+                    T *dst = reinterpret_cast<T *>(tmp[c].get()) + std::size_t(i) * this->stride;
+                    // sum of a row between two columns is the difference of two rows of the table, the same for a column
+                    const std::uint64_t *above = tables[c]->row(i);
+                    const std::uint64_t *below = tables[c]->row(i + 1);
+                    const std::uint64_t *top = nullptr;
+                    const std::uint64_t *bottom = nullptr;
+                    // samples of the vertical arm, the pixel itself is in both arms, so it is counted once
+                    std::uint64_t column = 0;
+                    if(vertical >= 0) {
+                        top = tables[c]->row(std::max(i - vertical, 0));
+                        bottom = tables[c]->row(std::min(i + vertical, this->height - 1) + 1);
+                        column = std::min(i + vertical, this->height - 1) - std::max(i - vertical, 0) + 1 - (horizontal >= 0 ? 1 : 0);
+                    }
+                    auto window = [&](int j, int left, int right) {
+                        std::uint64_t sum = 0;
+                        if(horizontal >= 0) {
+                            sum += below[right] - below[left] - above[right] + above[left];
+                        }
+                        if(vertical >= 0) {
+                            sum += bottom[j + 1] - bottom[j] - top[j + 1] + top[j];
+                            if(horizontal >= 0) {
+                                sum -= src[j];
+                            }
+                        }
+                        return sum;
+                    };
+                    auto border = [&](int from, int to) {
+                        for(int j = from; j < to; ++j) {
+                            int left = (horizontal >= 0 ? std::max(j - horizontal, 0) : j);
+                            int right = (horizontal >= 0 ? std::min(j + horizontal, this->width - 1) + 1 : j);
+                            dst[j] = T(window(j, left, right) / (right - left + column));
+                        }
+                    };
+                    // horizontal arm is not cut by borders of the image between these columns
+                    int arm = std::max(horizontal, 0);
+                    int inner_begin = std::min(arm, this->width - 1);
+                    int inner_end = std::max(this->width - arm - 1, inner_begin);
+                    border(0, inner_begin);
+                    divideBy<std::uint64_t>((horizontal >= 0 ? 2 * horizontal + 1 : 0) + column, this->depth, [&](auto divide) {
+                        for(int j = inner_begin; j < inner_end; ++j) {
+                            dst[j] = T(divide(window(j, j - arm, j + arm + 1)));
+                        }
+                    });
+                    border(inner_end, this->width - 1);
+                    if(post) {
+                        post->apply(dst, this->stride);
+                    }
                 }
             }
-            tmp[i][j] += left + right;
-            tmp[i][j] /= counter + 1;
-            if(tmp[i][j] > this->depth) {
-                tmp[i][j] = this->depth;
+        });
+        if(post) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                post->apply(reinterpret_cast<T *>(tmp[c].get()) + std::size_t(this->height - 1) * this->stride, this->stride);
             }
         }
+    });
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        this->replace(c, tmp[c]);
     }
-    this->pixels[this->colour] = tmp;
 }
 
 
-void Image::verticalBlurring(int radius) {
-    int **tmp;
-    tmp = new int *[this->height];
-    for(int i = 0; i < this->height; ++i) {
-        tmp[i] = new int [this->width];
-        for(int j = 0; j < this->width; ++j) {
-            tmp[i][j] = this->pixels[this->colour][i][j];
-        }
+void Image::horizontalBlurring(int radius, const Lut *post) {
+    TRACE_SPAN("Image::horizontalBlurring");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    // blurred planes replace current ones, which may still be used by snapshots
+    std::shared_ptr<unsigned char> tmp[3];
+    std::size_t bytes = this->planeSize() * this->sample_size;
+    // window can not be wider than the image
+    int r = std::min(radius, this->width);
+    if(this->keepsSummedArea()) {
+        this->summedAreaBlurring(r, -1, post);
+        return;
     }
-        
-    for(int j = 0; j < this->width - 1; ++j) {
-        for(int i = 0; i < this->height - 1; ++i) {
-            int up = 0;
-            int down = 0;
-            int counter = 0;
-            for(int r = 1; r < radius + 1; ++r) {
-                if(i - r >= 0) {
-                    up += this->pixels[this->colour][i-r][j];
-                    counter++;
-                }
-                if(i + r <= this->height - 1) {
-                    down += this->pixels[this->colour][i+r][j];
-                    counter++;
+
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+        using Sum = std::conditional_t<sizeof(T) == 1, std::uint32_t, std::uint64_t>;
+        for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+            tmp[c] = this->allocatePlane();
+            std::memcpy(tmp[c].get(), this->plane<T>(c), bytes);
+        }
+
+        ThreadPool::instance().parallelFor(0, this->height - 1, [&](int first, int last) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                for(int i = first; i < last; ++i) {
+                    const T *src = this->row<T>(c, i);
+                    T *dst = reinterpret_cast<T *>(tmp[c].get()) + std::size_t(i) * this->stride;
+
+                    // window of the first pixel
+                    Sum sum = 0;
+                    for(int k = 0; k <= r && k < this->width; ++k) {
+                        sum += src[k];
+                    }
+                    for(int j = 0; j < this->width - 1; ++j) {
+                        int left = std::max(j - r, 0);
+                        int right = std::min(j + r, this->width - 1);
+                        dst[j] = T(sum / Sum(right - left + 1));
+
+                        // slide window one pixel to the right
+                        if(j + r + 1 < this->width) {
+                            sum += src[j + r + 1];
+                        }
+                        if(j - r >= 0) {
+                            sum -= src[j - r];
+                        }
+                    }
+                    if(post) {
+                        post->apply(dst, this->stride);
+                    }
                 }
             }
-            tmp[i][j] += up + down;
-            tmp[i][j] /= counter + 1;
-            if(tmp[i][j] > this->depth) {
-                tmp[i][j] = this->depth;
+        });
+        if(post) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                post->apply(reinterpret_cast<T *>(tmp[c].get()) + std::size_t(this->height - 1) * this->stride, this->stride);
             }
         }
+    });
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        this->replace(c, tmp[c]);
     }
-    this->pixels[this->colour] = tmp;
 }
 
 
-void Image::fullBlurring(int radius) {
-    int **tmp;
-    tmp = new int *[this->height];
-    for(int i = 0; i < this->height; ++i) {
-        tmp[i] = new int [this->width];
-        for(int j = 0; j < this->width; ++j) {
-            tmp[i][j] = this->pixels[this->colour][i][j];
-        }
+void Image::verticalBlurring(int radius, const Lut *post) {
+    TRACE_SPAN("Image::verticalBlurring");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    // blurred planes replace current ones, which may still be used by snapshots
+    std::shared_ptr<unsigned char> tmp[3];
+    std::size_t bytes = this->planeSize() * this->sample_size;
+    // window can not be higher than the image
+    int r = std::min(radius, this->height);
+    if(this->keepsSummedArea()) {
+        this->summedAreaBlurring(-1, r, post);
+        return;
     }
 
-    for(int i = 0; i < this->height - 1; ++i) {
-        for(int j = 0; j < this->width - 1; ++j) {
-            int up = 0;
-            int down = 0;
-            int left = 0;
-            int right = 0;
-            int counter = 0;
-            for(int r = 1; r < radius + 1; ++r) {
-                if(i - r >= 0) {
-                    up += this->pixels[this->colour][i-r][j];
-                    counter++;
-                }
-                if(i + r <= this->height - 1) {
-                    down += this->pixels[this->colour][i+r][j];
-                    counter++;
-                }
-                if(j - r >= 0) {
-                    left += this->pixels[this->colour][i][j-r];
-                    counter++;
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+        using Sum = std::conditional_t<sizeof(T) == 1, std::uint32_t, std::uint64_t>;
+        int strip = STRIP_BYTES / sizeof(Sum);
+        // rows above and below the image are read as zeros, so the window always slides in the same way
+        Scratch::Frame frame;
+        const T *zeros = frame.take<T>(this->stride, 0);
+        for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+            tmp[c] = this->allocatePlane();
+            std::memcpy(tmp[c].get(), this->plane<T>(c), bytes);
+        }
+
+        ThreadPool::instance().parallelFor(0, this->height - 1, [&](int first, int last) {
+            // running sum of window for every column of a strip
+            Scratch::Frame band;
+            Sum *sums = band.take<Sum>(strip, 0);
+
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                for(int begin = 0; begin < this->width - 1; begin += strip) {
+                    int end = std::min(begin + strip, this->width - 1);
+
+                    // window of the first row of the band
+                    std::fill(sums, sums + strip, 0);
+                    for(int k = std::max(first - r, 0); k <= first + r && k < this->height; ++k) {
+                        const T *src = this->row<T>(c, k);
+                        for(int j = begin; j < end; ++j) {
+                            sums[j - begin] += src[j];
+                        }
+                    }
+                    for(int i = first; i < last; ++i) {
+                        T *dst = reinterpret_cast<T *>(tmp[c].get()) + std::size_t(i) * this->stride;
+                        const T *added = (i + r + 1 < this->height ? this->row<T>(c, i + r + 1) : zeros);
+                        const T *removed = (i - r >= 0 ? this->row<T>(c, i - r) : zeros);
+                        int up = std::max(i - r, 0);
+                        int down = std::min(i + r, this->height - 1);
+
+                        // every pixel is computed and its window slides one row down in one pass
+                        divideBy<Sum>(down - up + 1, this->depth, [&](auto divide) {
+                            for(int j = begin; j < end; ++j) {
+                                dst[j] = T(divide(sums[j - begin]));
+                                sums[j - begin] += added[j] - removed[j];
+                            }
+                        });
+                    }
                 }
-                if(j + r <= this->width - 1) {
-                    right += this->pixels[this->colour][i][j+r];
-                    counter++;
+                // rows are finished after all strips, also when the image is one pixel wide and there are no strips
+                if(post) {
+                    for(int i = first; i < last; ++i) {
+                        post->apply(reinterpret_cast<T *>(tmp[c].get()) + std::size_t(i) * this->stride, this->stride);
+                    }
                 }
             }
-            tmp[i][j] += up + down + left + right;
-            tmp[i][j] /= counter + 1;
-            if(tmp[i][j] > this->depth) {
-                tmp[i][j] = this->depth;
+        });
+        if(post) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                post->apply(reinterpret_cast<T *>(tmp[c].get()) + std::size_t(this->height - 1) * this->stride, this->stride);
             }
         }
+    });
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        this->replace(c, tmp[c]);
     }
-    this->pixels[this->colour] = tmp;
 }
 
 
-void Image::histogramStretching() {
-    int min = this->depth;
-    int max = 0;
-
-    for(int i = 0; i < this->height; ++i) {
-        for(int j = 0; j < this->width; ++j) {
-            int current = this->pixels[this->colour][i][j];
-            if(current > max) {
-                max = current;
+void Image::fullBlurring(int radius, const Lut *post) {
+    TRACE_SPAN("Image::fullBlurring");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    // blurred planes replace current ones, which may still be used by snapshots
+    std::shared_ptr<unsigned char> tmp[3];
+    std::size_t bytes = this->planeSize() * this->sample_size;
+    // window can not be wider or higher than the image
+    int r = std::min(radius, std::max(this->width, this->height));
+    if(this->keepsSummedArea()) {
+        this->summedAreaBlurring(r, r, post);
+        return;
+    }
+
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+        using Sum = std::conditional_t<sizeof(T) == 1, std::uint32_t, std::uint64_t>;
+        int strip = STRIP_BYTES / sizeof(Sum);
+        Scratch::Frame frame;
+        const T *zeros = frame.take<T>(this->stride, 0);
+        for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+            tmp[c] = this->allocatePlane();
+            std::memcpy(tmp[c].get(), this->plane<T>(c), bytes);
+        }
+
+        ThreadPool::instance().parallelFor(0, this->height - 1, [&](int first, int last) {
+            // running sum of vertical arm for every column of a strip
+            Scratch::Frame band;
+            Sum *sums = band.take<Sum>(strip, 0);
+
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                for(int begin = 0; begin < this->width - 1; begin += strip) {
+                    int end = std::min(begin + strip, this->width - 1);
+                    // horizontal arm is not cut by borders of the image between these columns
+                    int inner_begin = std::clamp(r, begin, end);
+                    int inner_end = std::clamp(this->width - r - 1, inner_begin, end);
+
+                    std::fill(sums, sums + strip, 0);
+                    for(int k = std::max(first - r, 0); k <= first + r && k < this->height; ++k) {
+                        const T *src = this->row<T>(c, k);
+                        for(int j = begin; j < end; ++j) {
+                            sums[j - begin] += src[j];
+                        }
+                    }
+                    for(int i = first; i < last; ++i) {
+                        const T *src = this->row<T>(c, i);
+                        T *dst = reinterpret_cast<T *>(tmp[c].get()) + std::size_t(i) * this->stride;
+                        const T *added = (i + r + 1 < this->height ? this->row<T>(c, i + r + 1) : zeros);
+                        const T *removed = (i - r >= 0 ? this->row<T>(c, i - r) : zeros);
+                        int vertical = std::min(i + r, this->height - 1) - std::max(i - r, 0) + 1;
+
+                        // horizontal window of the first pixel of the strip
+                        Sum sum = 0;
+                        for(int k = std::max(begin - r, 0); k <= begin + r && k < this->width; ++k) {
+                            sum += src[k];
+                        }
+
+                        // window is a cross, so the pixel itself is in both arms and it is counted once
+                        auto border = [&](int from, int to) {
+                            for(int j = from; j < to; ++j) {
+                                int horizontal = std::min(j + r, this->width - 1) - std::max(j - r, 0) + 1;
+                                dst[j] = T((sum + sums[j - begin] - src[j]) / Sum(horizontal + vertical - 1));
+                                if(j + r + 1 < this->width) {
+                                    sum += src[j + r + 1];
+                                }
+                                if(j - r >= 0) {
+                                    sum -= src[j - r];
+                                }
+                                sums[j - begin] += added[j] - removed[j];
+                            }
+                        };
+                        border(begin, inner_begin);
+                        divideBy<Sum>(2 * r + vertical, this->depth, [&](auto divide) {
+                            for(int j = inner_begin; j < inner_end; ++j) {
+                                dst[j] = T(divide(sum + sums[j - begin] - src[j]));
+                                sum += src[j + r + 1];
+                                sum -= src[j - r];
+                                sums[j - begin] += added[j] - removed[j];
+                            }
+                        });
+                        border(inner_end, end);
+                    }
+                }
+                // rows are finished after all strips, also when the image is one pixel wide and there are no strips
+                if(post) {
+                    for(int i = first; i < last; ++i) {
+                        post->apply(reinterpret_cast<T *>(tmp[c].get()) + std::size_t(i) * this->stride, this->stride);
+                    }
+                }
             }
-            if(current < min) {
-                min = current;
+        });
+        if(post) {
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                post->apply(reinterpret_cast<T *>(tmp[c].get()) + std::size_t(this->height - 1) * this->stride, this->stride);
             }
         }
+    });
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        this->replace(c, tmp[c]);
     }
+}
 
-    for(int i = 0; i < this->height; ++i) {
-        for(int j = 0; j < this->width; ++j) {
-            int current = this->pixels[this->colour][i][j];
-            this->pixels[this->colour][i][j] = int((current - min) * this->depth / (max - min));
-            if(this->pixels[this->colour][i][j] > this->depth) {
-                this->pixels[this->colour][i][j] = this->depth;
+
+// Median filter keeps a histogram of every column of the window and a histogram of the window, which is the sum of histograms
+// of its columns(Perreault and Hebert), so cost of every pixel does not depend on radius. Moving down by one row changes
+// two samples of every column histogram, moving right adds one column histogram to the window and subtracts another one.
+// Histograms have two levels - coarse bins count high bits of samples and fine bins count whole samples. The window has
+// coarse bins updated for every pixel and fine bins of one coarse bin updated only when the median is in that bin(medianSpan).
+// Pixels outside the image are the nearest pixels of the image.
+// Columns of every band are walked in strips, so that histograms of columns stay in cache(see MEDIAN_STRIP_BYTES),
+// histograms are emptied at the end of every strip by removing rows of the last window.
+void Image::medianFiltering(int radius, const Lut *post) {
+    TRACE_SPAN("Image::medianFiltering");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    // filtered planes replace current ones, which may still be used by snapshots
+    std::shared_ptr<unsigned char> tmp[3];
+    // column counts fit in 8 bits and window counts in 16 bits
+    int r = std::min(radius, MAX_MEDIAN_RADIUS);
+    int size = 2 * r + 1;
+    // index of the median among sorted samples of the window
+    int rank = size * size / 2;
+
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+        // coarse bin of a sample is its high bits, there are 16 coarse bins of 8-bit and 256 of 16-bit samples
+        constexpr int SHIFT = (sizeof(T) == 1 ? 4 : 8);
+        constexpr int BINS = 1 << SHIFT;
+        // fine bins of every column are kept only for coarse bins that samples can fall into
+        std::size_t fine_bins = std::size_t((this->depth >> SHIFT) + 1) * BINS;
+        // every column of a strip takes its coarse and fine bins and its source, the window takes 16-bit counts of both
+        // and the position of the last update of every coarse bin, a strip is at least as wide as the window,
+        // so that columns around it do not outnumber its own ones
+        std::size_t column_bytes = BINS + fine_bins + sizeof(int);
+        std::size_t window_bytes = (BINS + fine_bins) * sizeof(std::uint16_t) + BINS * sizeof(int);
+        int strip = std::max(int((MEDIAN_STRIP_BYTES - window_bytes) / column_bytes) - 2 * r, size);
+        for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+            tmp[c] = this->allocatePlane();
+        }
+
+        ThreadPool::instance().parallelFor(0, this->height, [&](int first, int last) {
+            Scratch::Frame band;
+            int columns = std::min(strip, this->width) + 2 * r;
+            std::uint8_t *coarse = band.take<std::uint8_t>(std::size_t(columns) * BINS, 0);
+            std::uint8_t *fine = band.take<std::uint8_t>(columns * fine_bins, 0);
+            std::uint16_t *window_coarse = band.take<std::uint16_t>(BINS, 0);
+            std::uint16_t *window_fine = band.take<std::uint16_t>(fine_bins, 0);
+            // position of the window at which fine bins of every coarse bin were updated, -1 when they are not valid
+            int *updated = band.take<int>(BINS, -1);
+            // column of the image of every column of a strip
+            int *source = band.take<int>(columns, 0);
+
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                for(int x = 0; x < this->width; x += strip) {
+                    int count = std::min(strip, this->width - x);
+                    for(int p = 0; p < count + 2 * r; ++p) {
+                        source[p] = std::clamp(x - r + p, 0, this->width - 1);
+                    }
+                    // add(or remove with step == 255, which wraps around) a row to histograms of all columns of the strip
+                    auto change = [&](int i, std::uint8_t step) {
+                        const T *src = this->row<T>(c, std::clamp(i, 0, this->height - 1));
+                        for(int p = 0; p < count + 2 * r; ++p) {
+                            T value = src[source[p]];
+                            coarse[std::size_t(p) * BINS + (value >> SHIFT)] += step;
+                            fine[p * fine_bins + value] += step;
+                        }
+                    };
+
+                    for(int i = first - r; i < first + r; ++i) {
+                        change(i, 1);
+                    }
+                    for(int i = first; i < last; ++i) {
+                        T *dst = reinterpret_cast<T *>(tmp[c].get()) + std::size_t(i) * this->stride + x;
+                        // slide window one row down
+                        if(i > first) {
+                            change(i - r - 1, 255);
+                        }
+                        change(i + r, 1);
+
+                        medianSpan(coarse, fine, fine_bins, window_coarse, window_fine, updated, dst, count, size, rank);
+                        if(post) {
+                            post->apply(dst, count);
+                        }
+                    }
+
+                    // histograms are empty for the next strip
+                    for(int i = last - r - 1; i <= last - 1 + r; ++i) {
+                        change(i, 255);
+                    }
+                }
             }
+        });
+    });
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        this->replace(c, tmp[c]);
+    }
+}
+
+
+void Image::convolution(const ConvolutionKernel &kernel, const Lut *post) {
+    TRACE_SPAN("Image::convolution");
+    TRACE_COUNT(TRACE_PIXELS, static_cast<std::uint64_t>(this->width) * this->height);
+    // convolved planes replace current ones, which may still be used by snapshots
+    std::shared_ptr<unsigned char> tmp[3];
+    int taps = kernel.getSize();
+    int r = kernel.getRadius();
+    std::vector<float> vertical;
+    std::vector<float> horizontal;
+    std::vector<std::vector<float>> lines;
+    bool separable = kernel.separate(vertical, horizontal);
+
+    // kernel that is not separable is the sum of 1-D convolutions with its rows, which are added up with equal weights
+    if(!separable) {
+        vertical.assign(taps, 1.0f);
+        for(int k = 0; k < taps; ++k) {
+            lines.push_back(kernel.row(k));
         }
     }
+
+    this->dispatch([&](auto sample) {
+        using T = decltype(sample);
+        for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+            tmp[c] = this->allocatePlane();
+        }
+
+        ThreadPool::instance().parallelFor(0, this->height, [&](int first, int last) {
+            Scratch::Frame band;
+            std::size_t padded = std::size_t(this->width) + 2 * r;
+            // source rows converted to floats, with their first and last pixel repeated r times, so that the horizontal pass
+            // needs no checks of borders, source row k is kept in slot k % taps while it is needed(only one slot for separable kernel)
+            float *wide = band.take<float>((separable ? 1 : taps) * padded, 0.0f);
+            // rows convolved horizontally, in the same slots as source rows of not separable kernel
+            float *ring = band.take<float>(std::size_t(taps) * this->width, 0.0f);
+            const float **rows = band.take<const float *>(taps, nullptr);
+
+            auto widen = [&](int c, int k) {
+                float *slot = wide + (separable ? 0 : std::size_t(k % taps) * padded);
+                widenSpan(this->row<T>(c, k), slot + r, this->width);
+                std::fill(slot, slot + r, slot[r]);
+                std::fill(slot + r + this->width, slot + padded, slot[r + this->width - 1]);
+                return slot;
+            };
+
+            for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+                int next = std::max(first - r, 0);
+                for(int i = first; i < last; ++i) {
+                    T *dst = reinterpret_cast<T *>(tmp[c].get()) + std::size_t(i) * this->stride;
+                    // every source row is converted(and convolved horizontally by separable kernel) once, when the first row that needs it is computed
+                    for(; next <= std::min(i + r, this->height - 1); ++next) {
+                        float *slot = widen(c, next);
+                        if(separable) {
+                            convolveRowSpan(slot, ring + std::size_t(next % taps) * this->width, this->width, horizontal.data(), taps);
+                        }
+                    }
+                    for(int k = 0; k < taps; ++k) {
+                        std::size_t slot = std::clamp(i + k - r, 0, this->height - 1) % taps;
+                        if(separable) {
+                            rows[k] = ring + slot * this->width;
+                        }
+                        else {
+                            // every row of the kernel is applied to its own source row
+                            convolveRowSpan(wide + slot * padded, ring + std::size_t(k) * this->width, this->width, lines[k].data(), taps);
+                            rows[k] = ring + std::size_t(k) * this->width;
+                        }
+                    }
+                    convolveColumnSpan(rows, dst, this->width, vertical.data(), taps, this->depth);
+                    if(post) {
+                        post->apply(dst, this->stride);
+                    }
+                }
+            }
+        });
+    });
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        this->replace(c, tmp[c]);
+    }
+}
+
+
+void Image::histogramStretching() {
+    TRACE_SPAN("Image::histogramStretching");
+    std::vector<Lut> luts;
+    ColourTables tables = {};
+
+    // histograms of all processed colours are counted in one pass
+    this->countHistograms(this->firstColour(), this->lastColour());
+    luts.reserve(3);
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        // table is built from extremes of the histogram, 64-bit products are used for 16-bit images
+        luts.push_back(Lut::stretching(this->depth, this->histograms[c]->min(), this->histograms[c]->max()));
+        tables[c] = &luts.back();
+    }
+    this->transform(tables);
+}
+
+
+void Image::histogramEqualization() {
+    TRACE_SPAN("Image::histogramEqualization");
+    std::vector<Lut> luts;
+    ColourTables tables = {};
+
+    this->countHistograms(this->firstColour(), this->lastColour());
+    luts.reserve(3);
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        luts.push_back(Lut::equalization(*this->histograms[c]));
+        tables[c] = &luts.back();
+    }
+    this->transform(tables);
+}
+
+
+void Image::percentileStretching(double clip) {
+    TRACE_SPAN("Image::percentileStretching");
+    std::vector<Lut> luts;
+    ColourTables tables = {};
+
+    this->countHistograms(this->firstColour(), this->lastColour());
+    luts.reserve(3);
+    for(int c = this->firstColour(); c < this->lastColour(); ++c) {
+        // samples beyond the percentiles are clamped to 0 and depth by the table
+        const Histogram &histogram = *this->histograms[c];
+        luts.push_back(Lut::stretching(this->depth, histogram.percentile(clip), histogram.percentile(1 - clip)));
+        tables[c] = &luts.back();
+    }
+    this->transform(tables);
 }
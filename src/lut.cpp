@@ -0,0 +1,144 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/lut.hh"
+#include "../inc/histogram.hh"
+#include <algorithm>
+#include <cmath>
+
+
+Lut::Lut(int depth) {
+    this->depth = depth;
+    this->table.resize(depth + 1);
+    for(int value = 0; value <= depth; ++value) {
+        this->table[value] = value;
+    }
+}
+
+
+Lut Lut::negative(int depth) {
+    Lut lut(depth);
+    for(int value = 0; value <= depth; ++value) {
+        lut.table[value] = depth - value;
+    }
+    return lut;
+}
+
+
+Lut Lut::threshold(int depth, int limit, int below, int above) {
+    Lut lut(depth);
+    for(int value = 0; value <= depth; ++value) {
+        int target = (value <= limit ? below : above);
+        lut.table[value] = (target < 0 ? value : target);
+    }
+    return lut;
+}
+
+
+Lut Lut::gamma(int depth, double gamma) {
+    Lut lut(depth);
+    for(int value = 0; value <= depth; ++value) {
+        lut.table[value] = int(pow((double(value) / double(depth)), (1.0 / gamma)) * depth);
+    }
+    return lut;
+}
+
+
+Lut Lut::level(int depth, double level) {
+    int black = depth * level;
+    int white = depth * (1 - level);
+
+    Lut lut(depth);
+    for(int value = 0; value <= depth; ++value) {
+        if(value <= black) {
+            lut.table[value] = 0;
+        }
+        else if(value < white) {
+            lut.table[value] = depth / (white - black) * (value - black);
+        }
+        else {
+            lut.table[value] = depth;
+        }
+    }
+    return lut;
+}
+
+
+Lut Lut::stretching(int depth, int min, int max) {
+    Lut lut(depth);
+    for(int value = 0; value <= depth; ++value) {
+        // values outside [min; max] are not in the histogram, but they are clamped so that every entry is valid
+        std::int64_t stretched = (max > min ? std::int64_t(value - min) * depth / (max - min) : value);
+        lut.table[value] = std::clamp<std::int64_t>(stretched, 0, depth);
+    }
+    return lut;
+}
+
+
+Lut Lut::equalization(const Histogram &histogram) {
+    int depth = histogram.getDepth();
+    Lut lut(depth);
+    // samples of the lowest value are mapped to 0, the rest is spread over [0; depth] by cumulative count
+    std::uint64_t lowest = histogram[histogram.min()];
+    std::uint64_t spread = histogram.getTotal() - lowest;
+    std::uint64_t cumulative = 0;
+
+    if(spread == 0) {
+        return lut;
+    }
+    for(int value = 0; value <= depth; ++value) {
+        cumulative += histogram[value];
+        double equalized = double(std::max(cumulative, lowest) - lowest) * depth / spread;
+        lut.table[value] = std::clamp<long>(std::lround(equalized), 0, depth);
+    }
+    return lut;
+}
+
+
+Lut Lut::then(const Lut &next) const {
+    Lut lut(this->depth);
+    for(int value = 0; value <= this->depth; ++value) {
+        lut.table[value] = next.table[this->table[value]];
+    }
+    return lut;
+}
+
+
+void Lut::apply(std::uint8_t *span, std::size_t size) const {
+    // narrow copy of the table, so that it takes only a few cache lines
+    std::uint8_t narrow[256] = {};
+    std::copy(this->table.begin(), this->table.end(), narrow);
+
+    for(std::size_t k = 0; k < size; ++k) {
+        span[k] = narrow[span[k]];
+    }
+}
+
+
+void Lut::apply(std::uint16_t *span, std::size_t size) const {
+    const std::uint16_t *table = this->table.data();
+
+    for(std::size_t k = 0; k < size; ++k) {
+        span[k] = table[span[k]];
+    }
+}
@@ -21,7 +21,12 @@ SOFTWARE.
 */
 
 
+#include "../inc/cli.hh"
+#include "../inc/convolution_kernel.hh"
+#include "../inc/history.hh"
 #include "../inc/image.hh"
+#include "../inc/pipeline.hh"
+#include "../inc/thread_pool.hh"
 #include <limits>
 
 
@@ -42,6 +47,7 @@ void printMenu() {
     std::cout << "\nUser menu - image processing\n";
     std::cout << "l - load an image\n";
     std::cout << "s - save current state of the image\n";
+    std::cout << "v - save current state of the image as text(P2/P3)\n";
     std::cout << "d - display current state of the image\n";
     std::cout << "c - select new colour that will be processed(only for colorful images)\n";
     std::cout << "o - convert PPM to PGM(only for colorful images)\n";
@@ -55,7 +61,15 @@ void printMenu() {
     std::cout << "x - add horizontal blurring filter to an image\n";
     std::cout << "y - add vertical blurring filter to an image\n";
     std::cout << "f - add full blurring filter to an image\n";
+    std::cout << "z - add median filter to an image\n";
+    std::cout << "i - add gaussian blurring filter to an image\n";
+    std::cout << "m - add sharpening filter to an image\n";
     std::cout << "h - add histogram stretching filter to an image\n";
+    std::cout << "e - add histogram equalization filter to an image\n";
+    std::cout << "p - add histogram stretching filter with clipped ends to an image\n";
+    std::cout << "u - undo the last change of the image\n";
+    std::cout << "r - redo the last undone change of the image\n";
+    std::cout << "j - set number of threads used by filters\n";
     std::cout << "q - quit the program\n";
 }
 
@@ -109,18 +123,29 @@ bool isInteger(std::string in) {
 }
 
 
-int main() {
+int main(int argc, char *argv[]) {
+    // arguments given - process an image without user menu
+    if(argc > 1) {
+        return runCommandLine(argc, argv);
+    }
+
     std::string selection = " ";    // for user's selection              
     bool loaded = false;            // whether or not image is loaded 
     std::string file_name;          // for loading and saving images
     Image img;                      // Image class object for our image
+    Pipeline pipeline(img);         // filters that have not been applied to the image yet
+    History history(pipeline);      // states of the image before and after changes, for undo and redo
 
     // parameters that are required by some functions
     double threshold;               // parameter for thresholding
     double level;                   // parameter for level adjustment
     double gamma;                   // parameter for gamma correction
     int radius;                     // parameter for blurring
+    double sigma;                   // parameter for gaussian blurring
+    double amount;                  // parameter for sharpening
+    double clip;                    // parameter for histogram stretching with clipped ends
     std::string param_val;          // entered value of parameter
+    std::string magnitude_val;      // entered magnitude of gradient for contouring
 
     while(selection[0] != 'q') {
         // user menu
@@ -139,6 +164,8 @@ int main() {
             case 'l':
                 std::cout << "Enter text file name with saved image: ";
                 std::cin >> file_name;
+                pipeline.clear();
+                history.clear();
                 loaded = img.load(file_name);
 
                 if(loaded) {
@@ -149,6 +176,7 @@ int main() {
                 if(loaded) {
                     std::cout << "Enter text file name with saved image: ";
                     std::cin >> file_name;
+                    pipeline.flush();
                     if(img.save(file_name)) {
                         std::cout << "Image saved successfully.\n";
                     }
@@ -157,10 +185,25 @@ int main() {
                     std::cerr << "Error. No image has been loaded yet.\n";
                 }
                 break;
+            case 'v':
+                if(loaded) {
+                    std::cout << "Enter text file name with saved image: ";
+                    std::cin >> file_name;
+                    pipeline.flush();
+                    if(img.save(file_name, false)) {
+                        std::cout << "Image saved successfully.\n";
+                    }
+                }
+                else {   
+                    std::cerr << "Error. No image has been loaded yet.\n";
+                }
+                break;
             case 'd':
                 if(loaded) {
-                    img.display();
-                    std::cout << "Image displayed successfully.\n";
+                    pipeline.flush();
+                    if(img.display()) {
+                        std::cout << "Image displayed successfully.\n";
+                    }
                 }
                 else {    
                     std::cerr << "Error. No image has been loaded yet.\n";
@@ -178,8 +221,19 @@ int main() {
                 break;
             case 'o':
                 if(loaded) {
-                    if(img.conversion2grey()) {
-                        std::cout << "Image converted successfully.\n";
+                    std::cout << "Select weights of colours(m - mean, 6 - luma of BT.601, 7 - luma of BT.709): ";
+                    std::cin >> param_val;
+                    if(param_val == "m" || param_val == "6" || param_val == "7") {
+                        if(img.getType() == 3) {
+                            history.checkpoint();
+                        }
+                        pipeline.flush();
+                        if(img.conversion2grey(param_val == "6" ? Image::BT601 : param_val == "7" ? Image::BT709 : Image::AVERAGE)) {
+                            std::cout << "Image converted successfully.\n";
+                        }
+                    }
+                    else {
+                        errorLog();
                     }
                 }
                 else {      
@@ -188,7 +242,8 @@ int main() {
                 break;
             case 'n':
                 if(loaded) {
-                    img.negative();
+                    history.checkpoint();
+                    pipeline.negative();
                     std::cout << "Negative filter added successfully.\n";
                 }
                 else {      
@@ -202,7 +257,8 @@ int main() {
                     if(isDouble(param_val)) {
                         threshold = std::atof(param_val.c_str());
                         if(threshold >= 0 && threshold <= 1) {
-                            img.thresholding(threshold);
+                            history.checkpoint();
+                            pipeline.thresholding(threshold);
                             std::cout << "Thresholding filter added successfully.\n";
                         }
                         else {
@@ -221,7 +277,8 @@ int main() {
                     if(isDouble(param_val)) {
                         threshold = std::atof(param_val.c_str()); 
                         if(threshold >= 0 && threshold <= 1) {
-                            img.halfThresholdingBlack(threshold);
+                            history.checkpoint();
+                            pipeline.halfThresholdingBlack(threshold);
                             std::cout << "Half-thresholding of black filter added successfully.\n";
                         }
                         else {
@@ -240,7 +297,8 @@ int main() {
                     if(isDouble(param_val)) {
                         threshold = std::atof(param_val.c_str());
                         if(threshold >= 0 && threshold <= 1) {
-                            img.halfThresholdingWhite(threshold);
+                            history.checkpoint();
+                            pipeline.halfThresholdingWhite(threshold);
                             std::cout << "Half-thresholding of white filter added successfully.\n";
                         }
                         else {
@@ -259,7 +317,8 @@ int main() {
                     if(isDouble(param_val)) {
                         gamma = std::atof(param_val.c_str());
                         if(gamma > 0) {
-                            img.gammaCorrection(gamma);
+                            history.checkpoint();
+                            pipeline.gammaCorrection(gamma);
                             std::cout << "Gamma correction filter added successfully.\n";
                         }
                         else {
@@ -278,7 +337,8 @@ int main() {
                     if(isDouble(param_val)) {
                         level = std::atof(param_val.c_str());
                         if(level > 0 && level < 0.5) {
-                            img.levelAdjustment(level);
+                            history.checkpoint();
+                            pipeline.levelAdjustment(level);
                             std::cout << "Level adjustment filter added successfully.\n";
                         }
                         else {
@@ -292,8 +352,18 @@ int main() {
                 break;
             case 'k':
                 if(loaded) {
-                    img.contouring();
-                    std::cout << "Contouring filter added successfully.\n";
+                    std::cout << "Select operator(d - differences of neighbours, s - Sobel, c - Scharr): ";
+                    std::cin >> param_val;
+                    std::cout << "Select magnitude(1 - sum of absolute values, 2 - length): ";
+                    std::cin >> magnitude_val;
+                    if((param_val == "d" || param_val == "s" || param_val == "c") && (magnitude_val == "1" || magnitude_val == "2")) {
+                        history.checkpoint();
+                        pipeline.gradient(param_val == "s" ? Image::SOBEL : param_val == "c" ? Image::SCHARR : Image::DIFFERENCES, magnitude_val == "2" ? Image::L2 : Image::L1);
+                        std::cout << "Contouring filter added successfully.\n";
+                    }
+                    else {
+                        errorLog();
+                    }
                 }
                 else {      
                     std::cerr << "Error. No image has been loaded yet.\n";
@@ -306,7 +376,8 @@ int main() {
                     if(isInteger(param_val)) {
                         radius = std::atoi(param_val.c_str());
                         if(radius > 0) {
-                            img.horizontalBlurring(radius);
+                            history.checkpoint();
+                            pipeline.horizontalBlurring(radius);
                             std::cout << "Horizontal blurring filter added successfully.\n";
                         }
                         else {
@@ -325,7 +396,8 @@ int main() {
                     if(isInteger(param_val)) {
                         radius = std::atoi(param_val.c_str());
                         if(radius > 0) {
-                            img.verticalBlurring(radius);
+                            history.checkpoint();
+                            pipeline.verticalBlurring(radius);
                             std::cout << "Vertical blurring filter added successfully.\n";
                         }
                         else {
@@ -344,7 +416,8 @@ int main() {
                     if(isInteger(param_val)) {
                         radius = std::atoi(param_val.c_str());
                         if(radius > 0) {
-                            img.fullBlurring(radius);
+                            history.checkpoint();
+                            pipeline.fullBlurring(radius);
                             std::cout << "Full blurring filter added successfully.\n";
                         }
                         else {
@@ -356,15 +429,136 @@ int main() {
                     std::cerr << "Error. No image has been loaded yet.\n";
                 }
                 break;
+            case 'z':
+                if(loaded) {
+                    std::cout << "Enter median radius value[1; 127]: ";
+                    std::cin >> param_val;
+                    if(isInteger(param_val)) {
+                        radius = std::atoi(param_val.c_str());
+                        if(radius > 0 && radius <= Image::MAX_MEDIAN_RADIUS) {
+                            history.checkpoint();
+                            pipeline.medianFiltering(radius);
+                            std::cout << "Median filter added successfully.\n";
+                        }
+                        else {
+                            std::cerr << "Improper value of radius.\n";
+                        }
+                    }
+                }
+                else {      
+                    std::cerr << "Error. No image has been loaded yet.\n";
+                }
+                break;
+            case 'i':
+                if(loaded) {
+                    std::cout << "Enter standard deviation value(0; 20]: ";
+                    std::cin >> param_val;
+                    if(isDouble(param_val)) {
+                        sigma = std::atof(param_val.c_str());
+                        if(sigma > 0 && sigma <= ConvolutionKernel::MAX_RADIUS / 3) {
+                            history.checkpoint();
+                            pipeline.convolution(ConvolutionKernel::gaussian(sigma));
+                            std::cout << "Gaussian blurring filter added successfully.\n";
+                        }
+                        else {
+                            std::cerr << "Improper value of standard deviation.\n";
+                        }
+                    }
+                }
+                else {      
+                    std::cerr << "Error. No image has been loaded yet.\n";
+                }
+                break;
+            case 'm':
+                if(loaded) {
+                    std::cout << "Enter sharpening amount value: ";
+                    std::cin >> param_val;
+                    if(isDouble(param_val)) {
+                        amount = std::atof(param_val.c_str());
+                        if(amount > 0) {
+                            history.checkpoint();
+                            pipeline.convolution(ConvolutionKernel::sharpen(amount));
+                            std::cout << "Sharpening filter added successfully.\n";
+                        }
+                        else {
+                            std::cerr << "Improper value of amount.\n";
+                        }
+                    }
+                }
+                else {      
+                    std::cerr << "Error. No image has been loaded yet.\n";
+                }
+                break;
             case 'h':
                 if(loaded) {
-                    img.histogramStretching();
+                    history.checkpoint();
+                    pipeline.histogramStretching();
                     std::cout << "Histogram stretching filter added successfully.\n";
                 }
                 else {      
                     std::cerr << "Error. No image has been loaded yet.\n";
                 }
                 break;
+            case 'e':
+                if(loaded) {
+                    history.checkpoint();
+                    pipeline.histogramEqualization();
+                    std::cout << "Histogram equalization filter added successfully.\n";
+                }
+                else {      
+                    std::cerr << "Error. No image has been loaded yet.\n";
+                }
+                break;
+            case 'p':
+                if(loaded) {
+                    std::cout << "Enter fraction of samples clipped at each end[0; 0.5): ";
+                    std::cin >> param_val;
+                    if(isDouble(param_val)) {
+                        clip = std::atof(param_val.c_str());
+                        if(clip >= 0 && clip < 0.5) {
+                            history.checkpoint();
+                            pipeline.percentileStretching(clip);
+                            std::cout << "Histogram stretching filter with clipped ends added successfully.\n";
+                        }
+                        else {
+                            std::cerr << "Improper value of clip.\n";
+                        }
+                    }
+                }
+                else {      
+                    std::cerr << "Error. No image has been loaded yet.\n";
+                }
+                break;
+            case 'u':
+                if(history.undo()) {
+                    std::cout << "Change undone successfully.\n";
+                }
+                else {
+                    std::cerr << "Error. There is no change to undo.\n";
+                }
+                break;
+            case 'r':
+                if(history.redo()) {
+                    std::cout << "Change redone successfully.\n";
+                }
+                else {
+                    std::cerr << "Error. There is no change to redo.\n";
+                }
+                break;
+            case 'j':
+                std::cout << "Enter number of threads(currently " << ThreadPool::instance().getThreads() << "): ";
+                std::cin >> param_val;
+                if(isInteger(param_val)) {
+                    int threads = std::atoi(param_val.c_str());
+                    if(threads > 0) {
+                        ThreadPool::instance().setThreads(threads);
+                        std::cout << "Number of threads set successfully.\n";
+                    }
+                    else {
+                        std::cerr << "Improper number of threads.\n";
+                    }
+                }
+                break;
             case 'q':
                 // program ends
                 break;
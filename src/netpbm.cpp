@@ -0,0 +1,431 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/netpbm.hh"
+#include "../inc/trace.hh"
+#include <iostream>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+#define FAIL false;
+#define SUCCESS true;
+
+
+// text samples are formatted into a buffer of at least this many bytes before it is written
+#define TEXT_CHUNK (1 << 20)
+// size of one formatted sample in the table of formatted samples
+#define TEXT_ENTRY 8
+
+
+NetpbmReader::~NetpbmReader() {
+    this->close();
+}
+
+
+bool NetpbmReader::open(std::string file_name, bool populate) {
+    TRACE_SPAN("NetpbmReader::open");
+    struct stat info;
+
+    this->close();
+
+    this->fd = ::open(file_name.c_str(), O_RDONLY);
+    if(this->fd < 0 || fstat(this->fd, &info) != 0 || info.st_size == 0) {
+        std::cerr << "Error. Could not load an image.\n";
+        return FAIL;
+    }
+
+    this->size = info.st_size;
+    void *mapping = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE | (populate ? MAP_POPULATE : 0), this->fd, 0);
+    if(mapping == MAP_FAILED) {
+        std::cerr << "Error. Could not load an image.\n";
+        return FAIL;
+    }
+    this->data = static_cast<const char *>(mapping);
+    // file is decoded from the beginning to the end exactly once
+    madvise(mapping, this->size, MADV_SEQUENTIAL);
+
+    // check whether input image is saved in pgm or ppm format or not
+    if(this->size < 2 || this->data[0] != 'P' || this->data[1] < '2' || this->data[1] > '6' || this->data[1] == '4') {
+        std::cerr << "Error. This is neither PGM nor PPM image.\n";
+        return FAIL;
+    }
+    this->img_type = (this->data[1] == '2' || this->data[1] == '5' ? 1 : 3);
+    this->binary = (this->data[1] == '5' || this->data[1] == '6');
+    this->position = 2;
+
+    // load image width, height and depth
+    if(!this->readNumber(this->width) || !this->readNumber(this->height) || !this->readNumber(this->depth)) {
+        std::cerr << "Error. Header of an image is damaged.\n";
+        return FAIL;
+    }
+
+    if(this->depth <= 0 || this->depth > 65535) {
+        std::cerr << "Error. Unsupported depth of an image.\n";
+        return FAIL;
+    }
+
+    if(this->binary) {
+        // exactly one whitespace separates header from raw samples
+        std::size_t bytes = std::size_t(this->width) * this->height * this->img_type * (this->depth <= 255 ? 1 : 2);
+        if(this->position + 1 + bytes > this->size) {
+            std::cerr << "Error. Image data is truncated.\n";
+            return FAIL;
+        }
+        this->position++;
+    }
+    TRACE_COUNT(TRACE_BYTES_READ, this->position);
+
+    return SUCCESS;
+}
+
+
+void NetpbmReader::close() {
+    if(this->data) {
+        munmap(const_cast<char *>(this->data), this->size);
+        this->data = nullptr;
+    }
+    if(this->fd >= 0) {
+        ::close(this->fd);
+        this->fd = -1;
+    }
+    this->size = 0;
+    this->position = 0;
+}
+
+
+bool NetpbmReader::readNumber(int &value) {
+    // skip whitespaces and comments
+    while(this->position < this->size) {
+        char current = this->data[this->position];
+        if(current == '#') {
+            while(this->position < this->size && this->data[this->position] != '\n') {
+                this->position++;
+            }
+        }
+        else if(current == ' ' || current == '\n' || current == '\r' || current == '\t' || current == '\v' || current == '\f') {
+            this->position++;
+        }
+        else {
+            break;
+        }
+    }
+
+    if(this->position >= this->size || this->data[this->position] < '0' || this->data[this->position] > '9') {
+        return FAIL;
+    }
+
+    value = 0;
+    while(this->position < this->size && this->data[this->position] >= '0' && this->data[this->position] <= '9') {
+        value = value * 10 + (this->data[this->position] - '0');
+        if(value > 0xFFFFFF) {
+            return FAIL;
+        }
+        this->position++;
+    }
+    return SUCCESS;
+}
+
+
+void NetpbmReader::release() {
+    std::size_t page = sysconf(_SC_PAGESIZE);
+    std::size_t bytes = this->position / page * page;
+
+    // mapping starts on a page boundary, pages are read from the file again if they are ever touched
+    if(this->data && bytes > 0) {
+        madvise(const_cast<char *>(this->data), bytes, MADV_DONTNEED);
+    }
+}
+
+
+template <typename T>
+bool NetpbmReader::readRows(int rows, T *const *planes, std::ptrdiff_t stride) {
+    TRACE_SPAN("NetpbmReader::readRows");
+    int channels = this->img_type;
+    T depth = T(this->depth);
+
+    if(!this->binary) {
+        return this->readTextRows(rows, planes, stride);
+    }
+
+    const unsigned char *source = reinterpret_cast<const unsigned char *>(this->data + this->position);
+    std::size_t row_bytes = std::size_t(this->width) * channels * sizeof(T);
+
+    for(int i = 0; i < rows; ++i) {
+        const unsigned char *raw = source + i * row_bytes;
+        if(sizeof(T) == 1 && channels == 1 && this->depth == 255) {
+            // every byte is a valid sample, so the row is just copied
+            std::memcpy(planes[0] + i * stride, raw, row_bytes);
+            continue;
+        }
+        for(int j = 0; j < this->width; ++j) {
+            for(int c = 0; c < channels; ++c) {
+                T value;
+                if(sizeof(T) == 1) {
+                    value = raw[j * channels + c];
+                }
+                else {
+                    // 16-bit samples are stored most significant byte first
+                    value = T(raw[2 * (j * channels + c)] << 8 | raw[2 * (j * channels + c) + 1]);
+                }
+                planes[c][i * stride + j] = (value <= depth ? value : depth);
+            }
+        }
+    }
+    this->position += rows * row_bytes;
+    TRACE_COUNT(TRACE_BYTES_READ, rows * row_bytes);
+
+    return SUCCESS;
+}
+
+
+template <typename T>
+bool NetpbmReader::readTextRows(int rows, T *const *planes, std::ptrdiff_t stride) {
+    int channels = this->img_type;
+    unsigned depth = this->depth;
+    const char *cursor = this->data + this->position;
+    const char *end = this->data + this->size;
+
+    // parse one sample, values above depth are clamped so that they fit in a sample
+    auto parse = [&](T &sample) {
+        // every control character and space is treated as a separator
+        while(cursor < end && static_cast<unsigned char>(*cursor) <= ' ') {
+            ++cursor;
+        }
+        unsigned value;
+        auto [next, error] = std::from_chars(cursor, end, value);
+        if(error != std::errc()) {
+            // comments are allowed between samples, but they are so rare that they are handled by slow path
+            this->position = cursor - this->data;
+            int commented;
+            if(cursor == end || *cursor != '#' || !this->readNumber(commented)) {
+                return false;
+            }
+            value = commented;
+            next = this->data + this->position;
+        }
+        cursor = next;
+        sample = T(value <= depth ? value : depth);
+        return true;
+    };
+
+    for(int i = 0; i < rows; ++i) {
+        bool parsed = true;
+        if(channels == 1) {
+            T *grey = planes[0] + i * stride;
+            for(int j = 0; j < this->width; ++j) {
+                parsed &= parse(grey[j]);
+            }
+        }
+        else {
+            T *red = planes[0] + i * stride;
+            T *green = planes[1] + i * stride;
+            T *blue = planes[2] + i * stride;
+            for(int j = 0; j < this->width; ++j) {
+                parsed &= parse(red[j]);
+                parsed &= parse(green[j]);
+                parsed &= parse(blue[j]);
+            }
+        }
+        if(!parsed) {
+            std::cerr << "Error. Image data is truncated.\n";
+            return FAIL;
+        }
+    }
+    TRACE_COUNT(TRACE_BYTES_READ, (cursor - this->data) - this->position);
+    this->position = cursor - this->data;
+
+    return SUCCESS;
+}
+
+
+template bool NetpbmReader::readRows<std::uint8_t>(int rows, std::uint8_t *const *planes, std::ptrdiff_t stride);
+template bool NetpbmReader::readRows<std::uint16_t>(int rows, std::uint16_t *const *planes, std::ptrdiff_t stride);
+
+
+NetpbmWriter::~NetpbmWriter() {
+    this->close();
+}
+
+
+bool NetpbmWriter::open(std::string file_name, int img_type, int width, int height, int depth, bool binary) {
+    this->close();
+
+    int fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        std::cerr << "Error. Could not save an image.\n";
+        return FAIL;
+    }
+
+    return this->attach(fd, img_type, width, height, depth, binary);
+}
+
+
+bool NetpbmWriter::attach(int fd, int img_type, int width, int height, int depth, bool binary) {
+    std::string header;
+
+    this->close();
+
+    this->fd = fd;
+    this->img_type = img_type;
+    this->width = width;
+    this->depth = depth;
+    this->binary = binary;
+
+    // every possible sample is formatted with std::to_chars only once, then it is just copied
+    if(!binary) {
+        this->texts.assign(std::size_t(depth + 1) * TEXT_ENTRY, ' ');
+        this->lengths.resize(depth + 1);
+        for(int value = 0; value <= depth; ++value) {
+            char *entry = this->texts.data() + std::size_t(value) * TEXT_ENTRY;
+            this->lengths[value] = std::to_chars(entry, entry + TEXT_ENTRY, value).ptr - entry + 1;
+        }
+    }
+
+    // write "magic number", width, height and depth
+    if(binary) {
+        header.append(img_type == 1 ? "P5\n" : "P6\n");
+    }
+    else {
+        header.append(img_type == 1 ? "P2\n" : "P3\n");
+    }
+    header.append(std::to_string(width) + " " + std::to_string(height) + " " + std::to_string(depth) + "\n");
+    this->buffer.assign(header.begin(), header.end());
+
+    return this->flush(header.size());
+}
+
+
+bool NetpbmWriter::close() {
+    bool result = SUCCESS;
+
+    if(this->fd >= 0) {
+        result = (::close(this->fd) == 0);
+        this->fd = -1;
+    }
+    this->buffer.clear();
+    this->buffer.shrink_to_fit();
+    this->texts.clear();
+    this->lengths.clear();
+    return result;
+}
+
+
+bool NetpbmWriter::flush(std::size_t bytes) {
+    const unsigned char *remaining = this->buffer.data();
+    std::size_t left = bytes;
+
+    while(left > 0) {
+        ssize_t written = write(this->fd, remaining, left);
+        if(written < 0) {
+            std::cerr << "Error. Could not save an image.\n";
+            return FAIL;
+        }
+        remaining += written;
+        left -= written;
+    }
+    TRACE_COUNT(TRACE_BYTES_WRITTEN, bytes);
+    return SUCCESS;
+}
+
+
+template <typename T>
+bool NetpbmWriter::writeRows(int rows, const T *const *planes, std::ptrdiff_t stride) {
+    TRACE_SPAN("NetpbmWriter::writeRows");
+    int channels = this->img_type;
+    std::size_t row_bytes = std::size_t(this->width) * channels * sizeof(T);
+
+    if(!this->binary) {
+        return this->writeTextRows(rows, planes, stride);
+    }
+
+    this->buffer.resize(rows * row_bytes);
+    unsigned char *raw = this->buffer.data();
+
+    for(int i = 0; i < rows; ++i) {
+        if(sizeof(T) == 1 && channels == 1) {
+            std::memcpy(raw, planes[0] + i * stride, row_bytes);
+            raw += row_bytes;
+            continue;
+        }
+        for(int j = 0; j < this->width; ++j) {
+            for(int c = 0; c < channels; ++c) {
+                T value = planes[c][i * stride + j];
+                if(sizeof(T) == 1) {
+                    *raw++ = value;
+                }
+                else {
+                    // 16-bit samples are stored most significant byte first
+                    *raw++ = value >> 8;
+                    *raw++ = value & 0xFF;
+                }
+            }
+        }
+    }
+
+    return this->flush(rows * row_bytes);
+}
+
+
+template <typename T>
+bool NetpbmWriter::writeTextRows(int rows, const T *const *planes, std::ptrdiff_t stride) {
+    int channels = this->img_type;
+    // longest sample is 5 digits and a space, every sample is copied as whole 8 byte entry
+    std::size_t row_chars = std::size_t(this->width) * channels * 6 + 1 + TEXT_ENTRY;
+
+    if(this->buffer.size() < TEXT_CHUNK + row_chars) {
+        this->buffer.resize(TEXT_CHUNK + row_chars);
+    }
+    char *begin = reinterpret_cast<char *>(this->buffer.data());
+    char *cursor = begin;
+    const char *texts = this->texts.data();
+    const unsigned char *lengths = this->lengths.data();
+
+    for(int i = 0; i < rows; ++i) {
+        for(int j = 0; j < this->width; ++j) {
+            for(int c = 0; c < channels; ++c) {
+                unsigned value = planes[c][i * stride + j];
+                std::memcpy(cursor, texts + value * TEXT_ENTRY, TEXT_ENTRY);
+                cursor += lengths[value];
+            }
+        }
+        *cursor++ = '\n';
+        // write the buffer when there is no space left for the next row
+        if(std::size_t(cursor - begin) >= TEXT_CHUNK) {
+            if(!this->flush(cursor - begin)) {
+                return FAIL;
+            }
+            cursor = begin;
+        }
+    }
+
+    return this->flush(cursor - begin);
+}
+
+
+template bool NetpbmWriter::writeRows<std::uint8_t>(int rows, const std::uint8_t *const *planes, std::ptrdiff_t stride);
+template bool NetpbmWriter::writeRows<std::uint16_t>(int rows, const std::uint16_t *const *planes, std::ptrdiff_t stride);
@@ -0,0 +1,302 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/pipeline.hh"
+#include "../inc/trace.hh"
+#include <utility>
+
+
+void Pipeline::record(Kind kind, double parameter, std::shared_ptr<const ConvolutionKernel> kernel) {
+    this->pending.push_back({kind, this->image.getColour(), parameter, std::move(kernel)});
+}
+
+
+bool Pipeline::isPoint(Kind kind) {
+    switch(kind) {
+    case NEGATIVE:
+    case THRESHOLDING:
+    case HALF_THRESHOLDING_BLACK:
+    case HALF_THRESHOLDING_WHITE:
+    case GAMMA_CORRECTION:
+    case LEVEL_ADJUSTMENT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+Lut Pipeline::table(const Operation &operation) const {
+    int depth = this->image.getDepth();
+    // the same limit as the one computed by filters of the image
+    int limit = operation.parameter * depth;
+
+    switch(operation.kind) {
+    case NEGATIVE:
+        return Lut::negative(depth);
+    case THRESHOLDING:
+        return Lut::threshold(depth, limit, 0, depth);
+    case HALF_THRESHOLDING_BLACK:
+        return Lut::threshold(depth, limit, 0, -1);
+    case HALF_THRESHOLDING_WHITE:
+        return Lut::threshold(depth, limit, -1, depth);
+    case GAMMA_CORRECTION:
+        return Lut::gamma(depth, operation.parameter);
+    case LEVEL_ADJUSTMENT:
+        return Lut::level(depth, operation.parameter);
+    default:
+        return Lut(depth);
+    }
+}
+
+
+std::size_t Pipeline::fuse(std::size_t first, int colour, Lut &lut) const {
+    std::size_t k = first;
+
+    while(k < this->pending.size() && isPoint(this->pending[k].kind) && this->pending[k].colour == colour) {
+        lut = lut.then(this->table(this->pending[k]));
+        ++k;
+    }
+    return k;
+}
+
+
+std::size_t Pipeline::fuseColours(std::size_t first, std::vector<Lut> &luts, ColourTables &tables) const {
+    std::size_t k = first;
+
+    while(k < this->pending.size() && isPoint(this->pending[k].kind)) {
+        Lut lut = this->table(this->pending[k]);
+        int colour = this->pending[k].colour;
+        int from = (colour == Image::ALL_COLOURS ? 0 : colour);
+        int to = (colour == Image::ALL_COLOURS ? this->image.getType() : colour + 1);
+        for(int c = from; c < to; ++c) {
+            luts[c] = luts[c].then(lut);
+            tables[c] = &luts[c];
+        }
+        ++k;
+    }
+    return k;
+}
+
+
+void Pipeline::apply(const Operation &operation, const Lut *post) {
+    switch(operation.kind) {
+    case NEGATIVE:
+        this->image.negative();
+        break;
+    case THRESHOLDING:
+        this->image.thresholding(operation.parameter);
+        break;
+    case HALF_THRESHOLDING_BLACK:
+        this->image.halfThresholdingBlack(operation.parameter);
+        break;
+    case HALF_THRESHOLDING_WHITE:
+        this->image.halfThresholdingWhite(operation.parameter);
+        break;
+    case GAMMA_CORRECTION:
+        this->image.gammaCorrection(operation.parameter);
+        break;
+    case LEVEL_ADJUSTMENT:
+        this->image.levelAdjustment(operation.parameter);
+        break;
+    case GRADIENT:
+        this->image.gradient(Image::GradientOperator(operation.parameter), operation.norm, post);
+        break;
+    case HORIZONTAL_BLURRING:
+        this->image.horizontalBlurring(int(operation.parameter), post);
+        break;
+    case VERTICAL_BLURRING:
+        this->image.verticalBlurring(int(operation.parameter), post);
+        break;
+    case FULL_BLURRING:
+        this->image.fullBlurring(int(operation.parameter), post);
+        break;
+    case MEDIAN_FILTERING:
+        this->image.medianFiltering(int(operation.parameter), post);
+        break;
+    case CONVOLUTION:
+        this->image.convolution(*operation.kernel, post);
+        break;
+    case HISTOGRAM_STRETCHING:
+        this->image.histogramStretching();
+        break;
+    case HISTOGRAM_EQUALIZATION:
+        this->image.histogramEqualization();
+        break;
+    case PERCENTILE_STRETCHING:
+        this->image.percentileStretching(operation.parameter);
+        break;
+    }
+}
+
+
+void Pipeline::flush() {
+    TRACE_SPAN("Pipeline::flush");
+    int selected = this->image.getColour();
+    std::size_t k = 0;
+
+    while(k < this->pending.size()) {
+        const Operation &operation = this->pending[k];
+        Lut lut(this->image.getDepth());
+
+        this->image.setColour(operation.colour);
+        if(isPoint(operation.kind)) {
+            std::vector<Lut> luts(3, lut);
+            ColourTables tables = {};
+            std::size_t next = this->fuseColours(k, luts, tables);
+            // single filter is applied by its own kernel, which is faster than a table
+            if(next == k + 1) {
+                this->apply(operation, nullptr);
+            }
+            else {
+                this->image.transform(tables);
+            }
+            k = next;
+        }
+        else if(operation.kind == HISTOGRAM_STRETCHING || operation.kind == HISTOGRAM_EQUALIZATION || operation.kind == PERCENTILE_STRETCHING) {
+            this->apply(operation, nullptr);
+            ++k;
+        }
+        else {
+            // value to value filters that follow are applied to rows while they are written
+            std::size_t next = this->fuse(k + 1, operation.colour, lut);
+            this->apply(operation, next > k + 1 ? &lut : nullptr);
+            k = next;
+        }
+    }
+
+    this->pending.clear();
+    this->image.setColour(selected);
+}
+
+
+void Pipeline::clear() {
+    this->pending.clear();
+}
+
+
+void Pipeline::Snapshot::releaseSummedAreas() {
+    this->image.releaseSummedAreas();
+}
+
+
+Pipeline::Snapshot Pipeline::snapshot() const {
+    Snapshot state;
+
+    state.image = this->image;
+    state.pending = this->pending;
+    return state;
+}
+
+
+void Pipeline::restore(const Snapshot &state) {
+    this->image = state.image;
+    this->pending = state.pending;
+}
+
+
+void Pipeline::restore(Snapshot &&state) {
+    this->image = std::move(state.image);
+    this->pending = std::move(state.pending);
+}
+
+
+bool Pipeline::empty() const {
+    return this->pending.empty();
+}
+
+
+void Pipeline::negative() {
+    this->record(NEGATIVE);
+}
+
+
+void Pipeline::thresholding(double threshold) {
+    this->record(THRESHOLDING, threshold);
+}
+
+
+void Pipeline::halfThresholdingBlack(double threshold) {
+    this->record(HALF_THRESHOLDING_BLACK, threshold);
+}
+
+
+void Pipeline::halfThresholdingWhite(double threshold) {
+    this->record(HALF_THRESHOLDING_WHITE, threshold);
+}
+
+
+void Pipeline::gammaCorrection(double gamma) {
+    this->record(GAMMA_CORRECTION, gamma);
+}
+
+
+void Pipeline::levelAdjustment(double level) {
+    this->record(LEVEL_ADJUSTMENT, level);
+}
+
+
+void Pipeline::gradient(Image::GradientOperator op, Image::GradientNorm norm) {
+    this->record(GRADIENT, op);
+    this->pending.back().norm = norm;
+}
+
+
+void Pipeline::horizontalBlurring(int radius) {
+    this->record(HORIZONTAL_BLURRING, radius);
+}
+
+
+void Pipeline::verticalBlurring(int radius) {
+    this->record(VERTICAL_BLURRING, radius);
+}
+
+
+void Pipeline::fullBlurring(int radius) {
+    this->record(FULL_BLURRING, radius);
+}
+
+
+void Pipeline::medianFiltering(int radius) {
+    this->record(MEDIAN_FILTERING, radius);
+}
+
+
+void Pipeline::convolution(const ConvolutionKernel &kernel) {
+    this->record(CONVOLUTION, 0, std::make_shared<const ConvolutionKernel>(kernel));
+}
+
+
+void Pipeline::histogramStretching() {
+    this->record(HISTOGRAM_STRETCHING);
+}
+
+
+void Pipeline::histogramEqualization() {
+    this->record(HISTOGRAM_EQUALIZATION);
+}
+
+
+void Pipeline::percentileStretching(double clip) {
+    this->record(PERCENTILE_STRETCHING, clip);
+}
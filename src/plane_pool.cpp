@@ -0,0 +1,112 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/plane_pool.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+
+
+// free blocks of two colour images, e.g. planes replaced by a blur of all colours
+#define POOL_BLOCKS 6
+
+
+PlanePool::PlanePool(std::size_t limit) : limit(limit) {
+}
+
+
+PlanePool::~PlanePool() {
+    this->trim();
+}
+
+
+PlanePool &PlanePool::instance() {
+    static PlanePool pool(POOL_BLOCKS);
+    return pool;
+}
+
+
+void PlanePool::release(unsigned char *memory, std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    this->blocks.push_back({memory, bytes});
+    if(this->blocks.size() > this->limit) {
+        std::free(this->blocks.front().memory);
+        this->blocks.erase(this->blocks.begin());
+    }
+}
+
+
+std::shared_ptr<unsigned char> PlanePool::wrap(unsigned char *memory, std::size_t bytes) {
+    return std::shared_ptr<unsigned char>(memory, [this, bytes](unsigned char *released) {
+        this->release(released, bytes);
+    });
+}
+
+
+std::shared_ptr<unsigned char> PlanePool::take(std::size_t bytes) {
+    unsigned char *memory = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto fits = [bytes](const Block &block) { return block.bytes == bytes; };
+        auto found = std::find_if(this->blocks.rbegin(), this->blocks.rend(), fits);
+
+        if(found != this->blocks.rend()) {
+            memory = found->memory;
+            this->blocks.erase(std::next(found).base());
+        }
+        for(const Block &block : this->blocks) {
+            if(block.bytes != bytes) {
+                std::free(block.memory);
+            }
+        }
+        this->blocks.erase(std::remove_if(this->blocks.begin(), this->blocks.end(), [&](const Block &block) { return !fits(block); }), this->blocks.end());
+    }
+
+    return (memory ? this->wrap(memory, bytes) : nullptr);
+}
+
+
+std::shared_ptr<unsigned char> PlanePool::allocate(std::size_t bytes, std::size_t alignment) {
+    unsigned char *memory = static_cast<unsigned char *>(std::aligned_alloc(alignment, bytes));
+    if(!memory) {
+        // memory kept by the pool may be enough for this plane
+        this->trim();
+        memory = static_cast<unsigned char *>(std::aligned_alloc(alignment, bytes));
+        if(!memory) {
+            throw std::bad_alloc();
+        }
+    }
+    return this->wrap(memory, bytes);
+}
+
+
+void PlanePool::trim() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    for(const Block &block : this->blocks) {
+        std::free(block.memory);
+    }
+    this->blocks.clear();
+}
@@ -0,0 +1,109 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/scratch.hh"
+#include <cstdlib>
+#include <new>
+
+
+// buffers start on a cache line, like rows of planes
+#define ALIGNMENT 64
+// the first block is big enough for buffers of most filters
+#define FIRST_BLOCK 65536
+
+
+Scratch::~Scratch() {
+    for(const Block &block : this->blocks) {
+        std::free(block.memory);
+    }
+}
+
+
+Scratch &Scratch::local() {
+    static thread_local Scratch arena;
+    return arena;
+}
+
+
+void *Scratch::take(std::size_t bytes) {
+    std::size_t needed = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+    if(this->blocks.empty() || this->used + needed > this->blocks[this->current].bytes) {
+        if(!this->blocks.empty() && this->current + 1 < this->blocks.size() && this->blocks[this->current + 1].bytes >= needed) {
+            ++this->current;
+        }
+        else {
+            // blocks after the current one hold no buffers, they are replaced by one block of all their memory
+            std::size_t size = std::max<std::size_t>(needed, FIRST_BLOCK);
+            for(std::size_t k = 0; k < this->blocks.size(); ++k) {
+                size += this->blocks[k].bytes;
+                if(k > this->current) {
+                    std::free(this->blocks[k].memory);
+                }
+            }
+            if(!this->blocks.empty()) {
+                this->blocks.resize(this->current + 1);
+            }
+            unsigned char *memory = static_cast<unsigned char *>(std::aligned_alloc(ALIGNMENT, size));
+            if(!memory) {
+                throw std::bad_alloc();
+            }
+            this->blocks.push_back({memory, size});
+            this->current = this->blocks.size() - 1;
+        }
+        this->used = 0;
+    }
+
+    void *buffer = this->blocks[this->current].memory + this->used;
+    this->used += needed;
+    return buffer;
+}
+
+
+void Scratch::rewind(std::size_t block, std::size_t offset) {
+    this->current = block;
+    this->used = offset;
+
+    // no buffer is taken, so all blocks are merged and the next filter takes all its buffers from one block
+    if(block == 0 && offset == 0 && this->blocks.size() > 1) {
+        std::size_t size = 0;
+        for(const Block &old : this->blocks) {
+            size += old.bytes;
+            std::free(old.memory);
+        }
+        this->blocks.clear();
+        unsigned char *memory = static_cast<unsigned char *>(std::aligned_alloc(ALIGNMENT, size));
+        if(memory) {
+            this->blocks.push_back({memory, size});
+        }
+    }
+}
+
+
+Scratch::Frame::Frame() : arena(Scratch::local()), block(arena.current), offset(arena.used) {
+}
+
+
+Scratch::Frame::~Frame() {
+    this->arena.rewind(this->block, this->offset);
+}
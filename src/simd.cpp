@@ -0,0 +1,865 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/simd.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <emmintrin.h>
+
+
+// Kernels are written once with GCC vector extensions and inlined into entry points compiled
+// for every instruction set, so each of them works on 16, 32 or 64 bytes at a time.
+#define KERNEL static inline __attribute__((always_inline))
+
+
+/**
+ * @brief Convert every lane of a vector to the type of lanes of another vector with the same number of lanes
+ * @param from converted vector
+ * @param to result of conversion
+ */
+template <typename To, typename From>
+KERNEL void convertLanes(const From &from, To &to) {
+    // GCC converts lanes one by one when integer lanes grow or shrink more than twice or when a float becomes an integer
+    // of another size, so such conversions are made of steps that vector instructions exist for
+    using FromLane = std::remove_cv_t<std::remove_reference_t<decltype(from[0])>>;
+    using ToLane = std::remove_cv_t<std::remove_reference_t<decltype(to[0])>>;
+    constexpr std::size_t lanes = sizeof(From) / sizeof(FromLane);
+    constexpr bool floating = std::is_floating_point_v<FromLane> || std::is_floating_point_v<ToLane>;
+    constexpr bool direct = (sizeof(FromLane) == sizeof(ToLane) || (!floating && (sizeof(FromLane) * 2 == sizeof(ToLane) || sizeof(ToLane) * 2 == sizeof(FromLane)))
+                             || (floating && sizeof(FromLane) >= 4 && sizeof(ToLane) >= 4));
+
+    if constexpr(direct) {
+        to = __builtin_convertvector(from, To);
+    }
+    else {
+        // floats become 32-bit integers first, integers are halved or doubled
+        using Step = std::conditional_t<floating, std::int32_t,
+                     std::conditional_t<(sizeof(FromLane) < sizeof(ToLane)),
+                                        std::conditional_t<sizeof(FromLane) == 1, std::uint16_t, std::uint32_t>,
+                                        std::conditional_t<sizeof(FromLane) == 4, std::uint16_t, std::uint8_t>>>;
+        typedef Step Middle __attribute__((vector_size(lanes * sizeof(Step))));
+        Middle middle;
+        convertLanes(from, middle);
+        convertLanes(middle, to);
+    }
+}
+
+
+template <int Bytes, typename T>
+KERNEL void negativeKernel(T *span, std::size_t size, int depth) {
+    typedef T Vector __attribute__((vector_size(Bytes)));
+    const std::size_t lanes = Bytes / sizeof(T);
+    Vector max = Vector{} + T(depth);
+    std::size_t k = 0;
+
+    for(; k + lanes <= size; k += lanes) {
+        Vector x;
+        std::memcpy(&x, span + k, Bytes);
+        x = max - x;
+        std::memcpy(span + k, &x, Bytes);
+    }
+    for(; k < size; ++k) {
+        span[k] = T(depth - span[k]);
+    }
+}
+
+
+template <int Bytes, typename T>
+KERNEL void thresholdKernel(T *span, std::size_t size, int limit, int below, int above) {
+    typedef T Vector __attribute__((vector_size(Bytes)));
+    const std::size_t lanes = Bytes / sizeof(T);
+    // new value is (sample & keep) | value, so one loop serves every kind of thresholding
+    T keep_below = (below < 0 ? T(~0) : T(0));
+    T value_below = (below < 0 ? T(0) : T(below));
+    T keep_above = (above < 0 ? T(~0) : T(0));
+    T value_above = (above < 0 ? T(0) : T(above));
+    Vector edge = Vector{} + T(limit);
+    std::size_t k = 0;
+
+    for(; k + lanes <= size; k += lanes) {
+        Vector x;
+        std::memcpy(&x, span + k, Bytes);
+        Vector mask = (Vector)(x <= edge);
+        Vector low = (x & keep_below) | value_below;
+        Vector high = (x & keep_above) | value_above;
+        x = (low & mask) | (high & ~mask);
+        std::memcpy(span + k, &x, Bytes);
+    }
+    for(; k < size; ++k) {
+        T x = span[k];
+        span[k] = (x <= limit ? T((x & keep_below) | value_below) : T((x & keep_above) | value_above));
+    }
+}
+
+
+template <int Bytes, typename T>
+KERNEL void levelKernel(T *span, std::size_t size, int black, int white, int depth) {
+    typedef T Vector __attribute__((vector_size(Bytes)));
+    const std::size_t lanes = Bytes / sizeof(T);
+    // product is exact in lanes that are kept, it is at most depth there
+    T factor = T(white > black ? depth / (white - black) : 0);
+    Vector low = Vector{} + T(black);
+    Vector high = Vector{} + T(white);
+    Vector max = Vector{} + T(depth);
+    std::size_t k = 0;
+
+    for(; k + lanes <= size; k += lanes) {
+        Vector x;
+        std::memcpy(&x, span + k, Bytes);
+        Vector above_black = (Vector)(x > low);
+        Vector white_or_more = (Vector)(x >= high);
+        Vector scaled = (x - low) * factor;
+        x = ((scaled & ~white_or_more) | (max & white_or_more)) & above_black;
+        std::memcpy(span + k, &x, Bytes);
+    }
+    for(; k < size; ++k) {
+        int current = span[k];
+        if(current <= black) {
+            span[k] = 0;
+        }
+        else if(current < white) {
+            span[k] = T(factor * (current - black));
+        }
+        else {
+            span[k] = T(depth);
+        }
+    }
+}
+
+
+// Types of 32-bit lanes are template parameters, so that vectors of them depend on the kernel's parameters
+// and GCC checks conversions of such vectors when the kernel is instantiated, not when it is parsed.
+template <int Bytes, typename T, typename Lane = std::uint32_t, typename Single = float>
+KERNEL void meanKernel(const T *red, const T *green, const T *blue, T *grey, std::size_t size) {
+    typedef T Vector __attribute__((vector_size(Bytes)));
+    const std::size_t lanes = Bytes / sizeof(T);
+    // sums are computed in 32-bit lanes, so one vector of samples becomes several registers
+    typedef Lane Wide __attribute__((vector_size(Bytes / sizeof(T) * 4)));
+    typedef Single Real __attribute__((vector_size(Bytes / sizeof(T) * 4)));
+    Real three = Real{} + 3.0f;
+    std::size_t k = 0;
+
+    for(; k + lanes <= size; k += lanes) {
+        Vector r, g, b;
+        std::memcpy(&r, red + k, Bytes);
+        std::memcpy(&g, green + k, Bytes);
+        std::memcpy(&b, blue + k, Bytes);
+        Wide wide_r, wide_g, wide_b;
+        convertLanes(r, wide_r);
+        convertLanes(g, wide_g);
+        convertLanes(b, wide_b);
+        Wide sum = wide_r + wide_g + wide_b;
+        Vector x;
+        if constexpr(sizeof(T) == 1) {
+            // floor(sum / 3) == (sum * 21846) >> 16 for every sum of three 8-bit samples
+            convertLanes(Wide((sum * 21846) >> 16), x);
+        }
+        else {
+            // quotient of sums below 2^22 is never rounded up to the next integer in single precision
+            Real real;
+            convertLanes(sum, real);
+            convertLanes(Real(real / three), x);
+        }
+        std::memcpy(grey + k, &x, Bytes);
+    }
+    for(; k < size; ++k) {
+        grey[k] = T((red[k] + green[k] + blue[k]) / 3);
+    }
+}
+
+
+template <int Bytes, typename T, typename Lane = std::uint32_t>
+KERNEL void lumaKernel(const T *red, const T *green, const T *blue, T *grey, std::size_t size, int wr, int wg, int wb) {
+    typedef T Vector __attribute__((vector_size(Bytes)));
+    const std::size_t lanes = Bytes / sizeof(T);
+    typedef Lane Wide __attribute__((vector_size(Bytes / sizeof(T) * 4)));
+    // weights sum up to 2^15, so weighted sum of 16-bit samples fits in 32 bits
+    const std::uint32_t half = 1 << 14;
+    std::size_t k = 0;
+
+    for(; k + lanes <= size; k += lanes) {
+        Vector r, g, b;
+        std::memcpy(&r, red + k, Bytes);
+        std::memcpy(&g, green + k, Bytes);
+        std::memcpy(&b, blue + k, Bytes);
+        Wide wide_r, wide_g, wide_b;
+        convertLanes(r, wide_r);
+        convertLanes(g, wide_g);
+        convertLanes(b, wide_b);
+        Wide sum = wide_r * Lane(wr) + wide_g * Lane(wg) + wide_b * Lane(wb) + half;
+        Vector x;
+        convertLanes(Wide(sum >> 15), x);
+        std::memcpy(grey + k, &x, Bytes);
+    }
+    for(; k < size; ++k) {
+        grey[k] = T((red[k] * std::uint32_t(wr) + green[k] * std::uint32_t(wg) + blue[k] * std::uint32_t(wb) + half) >> 15);
+    }
+}
+
+
+template <int Bytes, typename T, typename Single = float>
+KERNEL void widenKernel(const T *span, float *wide, std::size_t size) {
+    typedef Single Real __attribute__((vector_size(Bytes)));
+    const std::size_t lanes = Bytes / sizeof(float);
+    // one vector of floats is made of a narrower vector of samples
+    typedef T Narrow __attribute__((vector_size(Bytes / sizeof(float) * sizeof(T))));
+    std::size_t k = 0;
+
+    for(; k + lanes <= size; k += lanes) {
+        Narrow x;
+        std::memcpy(&x, span + k, sizeof(Narrow));
+        Real y;
+        convertLanes(x, y);
+        std::memcpy(wide + k, &y, Bytes);
+    }
+    for(; k < size; ++k) {
+        wide[k] = float(span[k]);
+    }
+}
+
+
+// Number of taps of common kernels is a template parameter, so that the loop over them is unrolled,
+// the generic version(Taps == 0) takes it at run time.
+template <int Bytes, int Taps, typename Single = float>
+KERNEL void convolveRowKernel(const float *span, float *result, std::size_t size, const float *weights, int taps) {
+    typedef Single Real __attribute__((vector_size(Bytes)));
+    const std::size_t lanes = Bytes / sizeof(float);
+    const int count = (Taps > 0 ? Taps : taps);
+    std::size_t k = 0;
+
+    for(; k + lanes <= size; k += lanes) {
+        Real sum = Real{};
+        #pragma GCC unroll 8
+        for(int t = 0; t < count; ++t) {
+            Real x;
+            std::memcpy(&x, span + k + t, Bytes);
+            sum += x * weights[t];
+        }
+        std::memcpy(result + k, &sum, Bytes);
+    }
+    for(; k < size; ++k) {
+        float sum = 0;
+        for(int t = 0; t < count; ++t) {
+            sum += span[k + t] * weights[t];
+        }
+        result[k] = sum;
+    }
+}
+
+
+template <int Bytes, int Taps, typename T, typename Single = float>
+KERNEL void convolveColumnKernel(const float *const *rows, T *result, std::size_t size, const float *weights, int taps, int depth) {
+    typedef Single Real __attribute__((vector_size(Bytes)));
+    typedef T Narrow __attribute__((vector_size(Bytes / sizeof(float) * sizeof(T))));
+    const std::size_t lanes = Bytes / sizeof(float);
+    const int count = (Taps > 0 ? Taps : taps);
+    Real low = Real{};
+    Real high = Real{} + float(depth);
+    std::size_t k = 0;
+
+    for(; k + lanes <= size; k += lanes) {
+        Real sum = Real{};
+        #pragma GCC unroll 8
+        for(int t = 0; t < count; ++t) {
+            Real x;
+            std::memcpy(&x, rows[t] + k, Bytes);
+            sum += x * weights[t];
+        }
+        // rounded to the nearest integer and clamped, weights of sharpening make sums out of range
+        sum += 0.5f;
+        sum = (sum < low ? low : sum);
+        sum = (sum > high ? high : sum);
+        Narrow x;
+        convertLanes(sum, x);
+        std::memcpy(result + k, &x, sizeof(Narrow));
+    }
+    for(; k < size; ++k) {
+        float sum = 0.5f;
+        for(int t = 0; t < count; ++t) {
+            sum += rows[t][k] * weights[t];
+        }
+        result[k] = T(sum < 0 ? 0 : sum > depth ? depth : sum);
+    }
+}
+
+
+template <int Bytes>
+KERNEL void convolveRowTaps(const float *span, float *result, std::size_t size, const float *weights, int taps) {
+    switch(taps) {
+    case 3:
+        convolveRowKernel<Bytes, 3>(span, result, size, weights, taps);
+        break;
+    case 5:
+        convolveRowKernel<Bytes, 5>(span, result, size, weights, taps);
+        break;
+    case 7:
+        convolveRowKernel<Bytes, 7>(span, result, size, weights, taps);
+        break;
+    default:
+        convolveRowKernel<Bytes, 0>(span, result, size, weights, taps);
+    }
+}
+
+
+template <int Bytes, typename T>
+KERNEL void convolveColumnTaps(const float *const *rows, T *result, std::size_t size, const float *weights, int taps, int depth) {
+    switch(taps) {
+    case 3:
+        convolveColumnKernel<Bytes, 3>(rows, result, size, weights, taps, depth);
+        break;
+    case 5:
+        convolveColumnKernel<Bytes, 5>(rows, result, size, weights, taps, depth);
+        break;
+    case 7:
+        convolveColumnKernel<Bytes, 7>(rows, result, size, weights, taps, depth);
+        break;
+    default:
+        convolveColumnKernel<Bytes, 0>(rows, result, size, weights, taps, depth);
+    }
+}
+
+
+// Square roots of four floats or two doubles are part of SSE2, which every x86-64 processor has, so they need no instruction set
+// of their own, wider vectors are split into parts of 16 bytes.
+template <typename Real>
+KERNEL void squareRoot(Real &x) {
+    for(std::size_t part = 0; part < sizeof(Real); part += 16) {
+        if constexpr(sizeof(x[0]) == sizeof(float)) {
+            __m128 quarter;
+            std::memcpy(&quarter, reinterpret_cast<char *>(&x) + part, 16);
+            quarter = _mm_sqrt_ps(quarter);
+            std::memcpy(reinterpret_cast<char *>(&x) + part, &quarter, 16);
+        }
+        else {
+            __m128d quarter;
+            std::memcpy(&quarter, reinterpret_cast<char *>(&x) + part, 16);
+            quarter = _mm_sqrt_pd(quarter);
+            std::memcpy(reinterpret_cast<char *>(&x) + part, &quarter, 16);
+        }
+    }
+}
+
+
+/**
+ * @brief Weights of gradient operators - differences of neighbours(Operator 0), Sobel(1) and Scharr(2),
+ *        side is the weight of the rows(columns) around the centre one and centre is its weight,
+ *        magnitude is divided by 2 * side + centre, so that a step of given height has the same magnitude for every operator
+ */
+template <int Operator>
+struct GradientWeights {
+    static constexpr int side = (Operator == 1 ? 1 : 3);
+    static constexpr int centre = (Operator == 1 ? 2 : 10);
+    static constexpr int shift = (Operator == 1 ? 2 : 4);
+};
+
+
+template <>
+struct GradientWeights<0> {
+    static constexpr int side = 0;
+    static constexpr int centre = 1;
+    static constexpr int shift = 0;
+};
+
+
+// Differences of neighbours are forward differences(right and below minus the centre) and Sobel and Scharr operators are central ones,
+// both components are computed in 32-bit lanes. Sum of absolute values is rounded by a shift. Squares of components of 8-bit samples
+// are exact in single precision, squares of 16-bit ones need double precision, so euclidean length is the same for every
+// instruction set(fused multiply-add or not) and vector lanes give the same results as the scalar border.
+template <int Operator, int Norm, typename T>
+KERNEL T gradientSample(const T *above, const T *current, const T *below, std::size_t left, std::size_t k, std::size_t right, int depth) {
+    using Weights = GradientWeights<Operator>;
+    int gx;
+    int gy;
+
+    if constexpr(Operator == 0) {
+        gx = current[right] - current[k];
+        gy = below[k] - current[k];
+    }
+    else {
+        gx = Weights::side * (above[right] - above[left]) + Weights::centre * (current[right] - current[left]) + Weights::side * (below[right] - below[left]);
+        gy = Weights::side * (below[left] - above[left]) + Weights::centre * (below[k] - above[k]) + Weights::side * (below[right] - above[right]);
+    }
+    int magnitude;
+    if constexpr(Norm == 0) {
+        magnitude = (std::abs(gx) + std::abs(gy) + (1 << Weights::shift >> 1)) >> Weights::shift;
+    }
+    else {
+        using Precise = std::conditional_t<sizeof(T) == 1, float, double>;
+        Precise x = Precise(gx);
+        Precise y = Precise(gy);
+        magnitude = int(std::sqrt(x * x + y * y) * (Precise(1) / (1 << Weights::shift)) + Precise(0.5));
+    }
+    return T(magnitude < depth ? magnitude : depth);
+}
+
+
+// vectors are passed by reference, returning them by value would depend on instruction set of the caller
+template <typename Narrow, typename Whole, typename T>
+KERNEL void loadWhole(const T *span, Whole &x) {
+    Narrow narrow;
+    std::memcpy(&narrow, span, sizeof(Narrow));
+    convertLanes(narrow, x);
+}
+
+
+template <int Bytes, int Operator, int Norm, typename T, typename Lane = std::int32_t, typename Single = float, typename Double = double>
+KERNEL void gradientKernel(const T *above, const T *current, const T *below, T *result, std::size_t size, int depth) {
+    using Weights = GradientWeights<Operator>;
+    using Precise = std::conditional_t<sizeof(T) == 1, Single, Double>;
+    typedef Lane Whole __attribute__((vector_size(Bytes)));
+    // doubles of 16-bit samples take two registers
+    typedef Precise Real __attribute__((vector_size(Bytes / sizeof(float) * sizeof(Precise))));
+    typedef T Narrow __attribute__((vector_size(Bytes / sizeof(float) * sizeof(T))));
+    const std::size_t lanes = Bytes / sizeof(float);
+    Whole zero = Whole{};
+    Whole max = Whole{} + depth;
+    std::size_t k = 1;
+
+    if(size == 0) {
+        return;
+    }
+    // the first and the last sample have no neighbour on one side, the nearest sample is used instead
+    result[0] = gradientSample<Operator, Norm>(above, current, below, 0, 0, std::min<std::size_t>(1, size - 1), depth);
+    for(; k + lanes < size; k += lanes) {
+        Whole gx;
+        Whole gy;
+        if constexpr(Operator == 0) {
+            Whole centre, right, down;
+            loadWhole<Narrow>(current + k, centre);
+            loadWhole<Narrow>(current + k + 1, right);
+            loadWhole<Narrow>(below + k, down);
+            gx = right - centre;
+            gy = down - centre;
+        }
+        else {
+            Whole above_left, above_middle, above_right, left, right, below_left, below_middle, below_right;
+            loadWhole<Narrow>(above + k - 1, above_left);
+            loadWhole<Narrow>(above + k, above_middle);
+            loadWhole<Narrow>(above + k + 1, above_right);
+            loadWhole<Narrow>(current + k - 1, left);
+            loadWhole<Narrow>(current + k + 1, right);
+            loadWhole<Narrow>(below + k - 1, below_left);
+            loadWhole<Narrow>(below + k, below_middle);
+            loadWhole<Narrow>(below + k + 1, below_right);
+            gx = Weights::side * (above_right - above_left + below_right - below_left) + Weights::centre * (right - left);
+            gy = Weights::side * (below_left - above_left + below_right - above_right) + Weights::centre * (below_middle - above_middle);
+        }
+        Whole magnitude;
+        if constexpr(Norm == 0) {
+            gx = (gx < zero ? -gx : gx);
+            gy = (gy < zero ? -gy : gy);
+            magnitude = (gx + gy + (1 << Weights::shift >> 1)) >> Weights::shift;
+        }
+        else {
+            Real x, y;
+            convertLanes(gx, x);
+            convertLanes(gy, y);
+            Real length = x * x + y * y;
+            squareRoot(length);
+            length = length * (Precise(1) / (1 << Weights::shift)) + Precise(0.5);
+            convertLanes(length, magnitude);
+        }
+        magnitude = (magnitude < max ? magnitude : max);
+        Narrow x;
+        convertLanes(magnitude, x);
+        std::memcpy(result + k, &x, sizeof(Narrow));
+    }
+    for(; k < size; ++k) {
+        result[k] = gradientSample<Operator, Norm>(above, current, below, k - 1, k, std::min(k + 1, size - 1), depth);
+    }
+}
+
+
+template <int Bytes, typename T>
+KERNEL void gradientOperators(const T *above, const T *current, const T *below, T *result, std::size_t size, int op, int norm, int depth) {
+    switch(op * 2 + norm) {
+    case 0:
+        gradientKernel<Bytes, 0, 0>(above, current, below, result, size, depth);
+        break;
+    case 1:
+        gradientKernel<Bytes, 0, 1>(above, current, below, result, size, depth);
+        break;
+    case 2:
+        gradientKernel<Bytes, 1, 0>(above, current, below, result, size, depth);
+        break;
+    case 3:
+        gradientKernel<Bytes, 1, 1>(above, current, below, result, size, depth);
+        break;
+    case 4:
+        gradientKernel<Bytes, 2, 0>(above, current, below, result, size, depth);
+        break;
+    default:
+        gradientKernel<Bytes, 2, 1>(above, current, below, result, size, depth);
+    }
+}
+
+
+// Counts of median filter are kept in 16-bit lanes, histograms of columns in 8-bit lanes, vectors are never wider than a histogram.
+template <int Bytes, int Bins>
+constexpr int countLanes = (Bytes / 2 < Bins ? Bytes / 2 : Bins);
+
+
+// add counts of the entering column and subtract counts of the leaving one, nullptr when a column is only added
+template <int Bytes, int Bins, typename Count = std::uint16_t, typename Column = std::uint8_t>
+KERNEL void slideCounts(std::uint16_t *counts, const std::uint8_t *enter, const std::uint8_t *leave) {
+    constexpr int lanes = countLanes<Bytes, Bins>;
+    typedef Count Counts __attribute__((vector_size(lanes * sizeof(Count))));
+    typedef Column Columns __attribute__((vector_size(lanes)));
+
+    for(int k = 0; k < Bins; k += lanes) {
+        Counts x;
+        Columns in, out;
+        Counts wide_in, wide_out;
+        std::memcpy(&x, counts + k, sizeof(Counts));
+        std::memcpy(&in, enter + k, sizeof(Columns));
+        convertLanes(in, wide_in);
+        if(leave) {
+            std::memcpy(&out, leave + k, sizeof(Columns));
+            convertLanes(out, wide_out);
+            wide_in -= wide_out;
+        }
+        x += wide_in;
+        std::memcpy(counts + k, &x, sizeof(Counts));
+    }
+}
+
+
+// number of samples in bins before the given one
+template <int Bytes, int Bins, typename Count = std::uint16_t>
+KERNEL int countBelow(const std::uint16_t *counts, int bin) {
+    constexpr int lanes = countLanes<Bytes, Bins>;
+    typedef Count Counts __attribute__((vector_size(lanes * sizeof(Count))));
+    Counts index;
+    Counts sum = Counts{};
+    int total = 0;
+
+    for(int l = 0; l < lanes; ++l) {
+        index[l] = Count(l);
+    }
+    // counts of bins before the given one are summed in vector lanes, sums never exceed number of samples of the window
+    for(int k = 0; k < Bins && k < bin; k += lanes) {
+        Counts x;
+        std::memcpy(&x, counts + k, sizeof(Counts));
+        sum += x & (Counts)(index < Count(bin - k));
+    }
+    for(int l = 0; l < lanes; ++l) {
+        total += sum[l];
+    }
+    return total;
+}
+
+
+/**
+ * @brief Find bin that holds sample of given rank, starting from a bin that is likely to be close to it,
+ *        e.g. the bin of the previous pixel
+ * @param counts counts of all bins
+ * @param start the first bin that is checked
+ * @param below number of samples before the first bin of counts, it becomes number of samples before the found bin
+ * @param rank index of the sample among sorted samples
+ * @return Index of the found bin
+ */
+template <int Bytes, int Bins>
+KERNEL int findBin(const std::uint16_t *counts, int start, int &below, int rank) {
+    int bin = start;
+
+    below += countBelow<Bytes, Bins>(counts, bin);
+    while(below > rank) {
+        --bin;
+        below -= counts[bin];
+    }
+    while(below + counts[bin] <= rank) {
+        below += counts[bin];
+        ++bin;
+    }
+    return bin;
+}
+
+
+// Coarse counts of the window are updated for every pixel, fine counts of a coarse bin only when the median is in it,
+// by columns that entered and left the window since the last update, or summed again when the whole window has changed.
+// The median is searched for from the bins of the previous pixel, which are usually the same or close.
+template <int Bytes, typename T>
+KERNEL void medianKernel(const std::uint8_t *coarse, const std::uint8_t *fine, std::size_t fine_bins, std::uint16_t *window_coarse,
+                         std::uint16_t *window_fine, int *updated, T *result, std::size_t size, int window, int rank) {
+    constexpr int BINS = (sizeof(T) == 1 ? 16 : 256);
+    int bin = 0;
+    int value = 0;
+
+    std::fill(window_coarse, window_coarse + BINS, 0);
+    for(int p = 0; p < window; ++p) {
+        slideCounts<Bytes, BINS>(window_coarse, coarse + std::size_t(p) * BINS, nullptr);
+    }
+    std::fill(updated, updated + BINS, -1);
+
+    for(std::size_t j = 0; j < size; ++j) {
+        if(j > 0) {
+            slideCounts<Bytes, BINS>(window_coarse, coarse + (j + window - 1) * BINS, coarse + (j - 1) * BINS);
+        }
+        int below = 0;
+        int previous = bin;
+        bin = findBin<Bytes, BINS>(window_coarse, bin, below, rank);
+
+        std::uint16_t *counts = window_fine + std::size_t(bin) * BINS;
+        const std::uint8_t *column = fine + std::size_t(bin) * BINS;
+        int last = updated[bin];
+        if(last < 0 || int(j) - last >= window) {
+            std::fill(counts, counts + BINS, 0);
+            for(std::size_t p = j; p < j + window; ++p) {
+                slideCounts<Bytes, BINS>(counts, column + p * fine_bins, nullptr);
+            }
+        }
+        else {
+            for(std::size_t p = last + 1; p <= j; ++p) {
+                slideCounts<Bytes, BINS>(counts, column + (p + window - 1) * fine_bins, column + (p - 1) * fine_bins);
+            }
+        }
+        updated[bin] = int(j);
+
+        value = findBin<Bytes, BINS>(counts, (bin == previous ? value : 0), below, rank);
+        result[j] = T(bin * BINS + value);
+    }
+}
+
+
+/**
+ * @brief Entry points of all kernels compiled for one instruction set
+ */
+struct Kernels {
+    const char *name;
+    void (*negative8)(std::uint8_t *, std::size_t, int);
+    void (*negative16)(std::uint16_t *, std::size_t, int);
+    void (*threshold8)(std::uint8_t *, std::size_t, int, int, int);
+    void (*threshold16)(std::uint16_t *, std::size_t, int, int, int);
+    void (*level8)(std::uint8_t *, std::size_t, int, int, int);
+    void (*level16)(std::uint16_t *, std::size_t, int, int, int);
+    void (*mean8)(const std::uint8_t *, const std::uint8_t *, const std::uint8_t *, std::uint8_t *, std::size_t);
+    void (*mean16)(const std::uint16_t *, const std::uint16_t *, const std::uint16_t *, std::uint16_t *, std::size_t);
+    void (*luma8)(const std::uint8_t *, const std::uint8_t *, const std::uint8_t *, std::uint8_t *, std::size_t, int, int, int);
+    void (*luma16)(const std::uint16_t *, const std::uint16_t *, const std::uint16_t *, std::uint16_t *, std::size_t, int, int, int);
+    void (*widen8)(const std::uint8_t *, float *, std::size_t);
+    void (*widen16)(const std::uint16_t *, float *, std::size_t);
+    void (*convolveRow)(const float *, float *, std::size_t, const float *, int);
+    void (*convolveColumn8)(const float *const *, std::uint8_t *, std::size_t, const float *, int, int);
+    void (*convolveColumn16)(const float *const *, std::uint16_t *, std::size_t, const float *, int, int);
+    void (*gradient8)(const std::uint8_t *, const std::uint8_t *, const std::uint8_t *, std::uint8_t *, std::size_t, int, int, int);
+    void (*gradient16)(const std::uint16_t *, const std::uint16_t *, const std::uint16_t *, std::uint16_t *, std::size_t, int, int, int);
+    void (*median8)(const std::uint8_t *, const std::uint8_t *, std::size_t, std::uint16_t *, std::uint16_t *, int *, std::uint8_t *, std::size_t, int, int);
+    void (*median16)(const std::uint8_t *, const std::uint8_t *, std::size_t, std::uint16_t *, std::uint16_t *, int *, std::uint16_t *, std::size_t, int, int);
+};
+
+
+// define entry points of every kernel for one instruction set, vectors are given number of bytes wide
+#define INSTRUCTION_SET(suffix, target_name, bytes, display_name) \
+    __attribute__((target(target_name))) static void negative8##suffix(std::uint8_t *span, std::size_t size, int depth) { \
+        negativeKernel<bytes>(span, size, depth); \
+    } \
+    __attribute__((target(target_name))) static void negative16##suffix(std::uint16_t *span, std::size_t size, int depth) { \
+        negativeKernel<bytes>(span, size, depth); \
+    } \
+    __attribute__((target(target_name))) static void threshold8##suffix(std::uint8_t *span, std::size_t size, int limit, int below, int above) { \
+        thresholdKernel<bytes>(span, size, limit, below, above); \
+    } \
+    __attribute__((target(target_name))) static void threshold16##suffix(std::uint16_t *span, std::size_t size, int limit, int below, int above) { \
+        thresholdKernel<bytes>(span, size, limit, below, above); \
+    } \
+    __attribute__((target(target_name))) static void level8##suffix(std::uint8_t *span, std::size_t size, int black, int white, int depth) { \
+        levelKernel<bytes>(span, size, black, white, depth); \
+    } \
+    __attribute__((target(target_name))) static void level16##suffix(std::uint16_t *span, std::size_t size, int black, int white, int depth) { \
+        levelKernel<bytes>(span, size, black, white, depth); \
+    } \
+    __attribute__((target(target_name))) static void mean8##suffix(const std::uint8_t *red, const std::uint8_t *green, const std::uint8_t *blue, std::uint8_t *grey, std::size_t size) { \
+        meanKernel<bytes>(red, green, blue, grey, size); \
+    } \
+    __attribute__((target(target_name))) static void mean16##suffix(const std::uint16_t *red, const std::uint16_t *green, const std::uint16_t *blue, std::uint16_t *grey, std::size_t size) { \
+        meanKernel<bytes>(red, green, blue, grey, size); \
+    } \
+    __attribute__((target(target_name))) static void luma8##suffix(const std::uint8_t *red, const std::uint8_t *green, const std::uint8_t *blue, std::uint8_t *grey, std::size_t size, int wr, int wg, int wb) { \
+        lumaKernel<bytes>(red, green, blue, grey, size, wr, wg, wb); \
+    } \
+    __attribute__((target(target_name))) static void luma16##suffix(const std::uint16_t *red, const std::uint16_t *green, const std::uint16_t *blue, std::uint16_t *grey, std::size_t size, int wr, int wg, int wb) { \
+        lumaKernel<bytes>(red, green, blue, grey, size, wr, wg, wb); \
+    } \
+    __attribute__((target(target_name))) static void widen8##suffix(const std::uint8_t *span, float *wide, std::size_t size) { \
+        widenKernel<bytes>(span, wide, size); \
+    } \
+    __attribute__((target(target_name))) static void widen16##suffix(const std::uint16_t *span, float *wide, std::size_t size) { \
+        widenKernel<bytes>(span, wide, size); \
+    } \
+    __attribute__((target(target_name))) static void convolveRow##suffix(const float *span, float *result, std::size_t size, const float *weights, int taps) { \
+        convolveRowTaps<bytes>(span, result, size, weights, taps); \
+    } \
+    __attribute__((target(target_name))) static void convolveColumn8##suffix(const float *const *rows, std::uint8_t *result, std::size_t size, const float *weights, int taps, int depth) { \
+        convolveColumnTaps<bytes>(rows, result, size, weights, taps, depth); \
+    } \
+    __attribute__((target(target_name))) static void convolveColumn16##suffix(const float *const *rows, std::uint16_t *result, std::size_t size, const float *weights, int taps, int depth) { \
+        convolveColumnTaps<bytes>(rows, result, size, weights, taps, depth); \
+    } \
+    __attribute__((target(target_name))) static void gradient8##suffix(const std::uint8_t *above, const std::uint8_t *current, const std::uint8_t *below, std::uint8_t *result, std::size_t size, int op, int norm, int depth) { \
+        gradientOperators<bytes>(above, current, below, result, size, op, norm, depth); \
+    } \
+    __attribute__((target(target_name))) static void gradient16##suffix(const std::uint16_t *above, const std::uint16_t *current, const std::uint16_t *below, std::uint16_t *result, std::size_t size, int op, int norm, int depth) { \
+        gradientOperators<bytes>(above, current, below, result, size, op, norm, depth); \
+    } \
+    __attribute__((target(target_name))) static void median8##suffix(const std::uint8_t *coarse, const std::uint8_t *fine, std::size_t fine_bins, std::uint16_t *window_coarse, std::uint16_t *window_fine, int *updated, std::uint8_t *result, std::size_t size, int window, int rank) { \
+        medianKernel<bytes>(coarse, fine, fine_bins, window_coarse, window_fine, updated, result, size, window, rank); \
+    } \
+    __attribute__((target(target_name))) static void median16##suffix(const std::uint8_t *coarse, const std::uint8_t *fine, std::size_t fine_bins, std::uint16_t *window_coarse, std::uint16_t *window_fine, int *updated, std::uint16_t *result, std::size_t size, int window, int rank) { \
+        medianKernel<bytes>(coarse, fine, fine_bins, window_coarse, window_fine, updated, result, size, window, rank); \
+    } \
+    static const Kernels kernels##suffix = { \
+        display_name, negative8##suffix, negative16##suffix, threshold8##suffix, threshold16##suffix, level8##suffix, level16##suffix, \
+        mean8##suffix, mean16##suffix, luma8##suffix, luma16##suffix, widen8##suffix, widen16##suffix, \
+        convolveRow##suffix, convolveColumn8##suffix, convolveColumn16##suffix, gradient8##suffix, gradient16##suffix, \
+        median8##suffix, median16##suffix \
+    };
+
+
+INSTRUCTION_SET(Sse2, "sse2", 16, "SSE2")
+INSTRUCTION_SET(Avx2, "avx2", 32, "AVX2")
+INSTRUCTION_SET(Avx512, "avx512f,avx512bw", 64, "AVX-512")
+
+
+/**
+ * @brief Select kernels for the widest instruction set supported by the processor
+ * @return Selected kernels
+ */
+static const Kernels &selectKernels() {
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return kernelsAvx512;
+    }
+    if(__builtin_cpu_supports("avx2")) {
+        return kernelsAvx2;
+    }
+    return kernelsSse2;
+}
+
+
+// kernels are selected once, before main is called
+static const Kernels &selected = selectKernels();
+
+
+const char *simdInstructionSet() {
+    return selected.name;
+}
+
+
+void negativeSpan(std::uint8_t *span, std::size_t size, int depth) {
+    selected.negative8(span, size, depth);
+}
+
+
+void negativeSpan(std::uint16_t *span, std::size_t size, int depth) {
+    selected.negative16(span, size, depth);
+}
+
+
+void thresholdSpan(std::uint8_t *span, std::size_t size, int limit, int below, int above) {
+    selected.threshold8(span, size, limit, below, above);
+}
+
+
+void thresholdSpan(std::uint16_t *span, std::size_t size, int limit, int below, int above) {
+    selected.threshold16(span, size, limit, below, above);
+}
+
+
+void levelSpan(std::uint8_t *span, std::size_t size, int black, int white, int depth) {
+    selected.level8(span, size, black, white, depth);
+}
+
+
+void levelSpan(std::uint16_t *span, std::size_t size, int black, int white, int depth) {
+    selected.level16(span, size, black, white, depth);
+}
+
+
+void meanSpan(const std::uint8_t *red, const std::uint8_t *green, const std::uint8_t *blue, std::uint8_t *grey, std::size_t size) {
+    selected.mean8(red, green, blue, grey, size);
+}
+
+
+void meanSpan(const std::uint16_t *red, const std::uint16_t *green, const std::uint16_t *blue, std::uint16_t *grey, std::size_t size) {
+    selected.mean16(red, green, blue, grey, size);
+}
+
+
+void lumaSpan(const std::uint8_t *red, const std::uint8_t *green, const std::uint8_t *blue, std::uint8_t *grey, std::size_t size, int wr, int wg, int wb) {
+    selected.luma8(red, green, blue, grey, size, wr, wg, wb);
+}
+
+
+void lumaSpan(const std::uint16_t *red, const std::uint16_t *green, const std::uint16_t *blue, std::uint16_t *grey, std::size_t size, int wr, int wg, int wb) {
+    selected.luma16(red, green, blue, grey, size, wr, wg, wb);
+}
+
+
+void widenSpan(const std::uint8_t *span, float *wide, std::size_t size) {
+    selected.widen8(span, wide, size);
+}
+
+
+void widenSpan(const std::uint16_t *span, float *wide, std::size_t size) {
+    selected.widen16(span, wide, size);
+}
+
+
+void convolveRowSpan(const float *span, float *result, std::size_t size, const float *weights, int taps) {
+    selected.convolveRow(span, result, size, weights, taps);
+}
+
+
+void convolveColumnSpan(const float *const *rows, std::uint8_t *result, std::size_t size, const float *weights, int taps, int depth) {
+    selected.convolveColumn8(rows, result, size, weights, taps, depth);
+}
+
+
+void convolveColumnSpan(const float *const *rows, std::uint16_t *result, std::size_t size, const float *weights, int taps, int depth) {
+    selected.convolveColumn16(rows, result, size, weights, taps, depth);
+}
+
+
+void gradientSpan(const std::uint8_t *above, const std::uint8_t *current, const std::uint8_t *below, std::uint8_t *result, std::size_t size, int op, int norm, int depth) {
+    selected.gradient8(above, current, below, result, size, op, norm, depth);
+}
+
+
+void gradientSpan(const std::uint16_t *above, const std::uint16_t *current, const std::uint16_t *below, std::uint16_t *result, std::size_t size, int op, int norm, int depth) {
+    selected.gradient16(above, current, below, result, size, op, norm, depth);
+}
+
+
+void medianSpan(const std::uint8_t *coarse, const std::uint8_t *fine, std::size_t fine_bins, std::uint16_t *window_coarse, std::uint16_t *window_fine,
+                int *updated, std::uint8_t *result, std::size_t size, int window, int rank) {
+    selected.median8(coarse, fine, fine_bins, window_coarse, window_fine, updated, result, size, window, rank);
+}
+
+
+void medianSpan(const std::uint8_t *coarse, const std::uint8_t *fine, std::size_t fine_bins, std::uint16_t *window_coarse, std::uint16_t *window_fine,
+                int *updated, std::uint16_t *result, std::size_t size, int window, int rank) {
+    selected.median16(coarse, fine, fine_bins, window_coarse, window_fine, updated, result, size, window, rank);
+}
@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/stream.hh"
+#include "../inc/netpbm.hh"
+#include "../inc/trace.hh"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+
+
+#define FAIL false;
+#define SUCCESS true;
+
+
+Stream::Stream(int band_rows, int above, int below) : band_rows(std::max(band_rows, 1)), above(std::max(above, 0)), below(std::max(below, 0)) {
+}
+
+
+bool Stream::run(const std::string &input, const std::string &output, bool binary, const std::function<bool(Image &)> &process) {
+    TRACE_SPAN("Stream::run");
+    NetpbmReader source;
+    NetpbmWriter file;
+    // bands are written next to the output, which is replaced at the end, so the output may be the input that is still read
+    std::string part = output + "." + std::to_string(getpid()) + ".part";
+    bool opened = false;
+    auto discard = [&]() {
+        if(opened) {
+            file.close();
+            std::remove(part.c_str());
+        }
+        return FAIL;
+    };
+
+    // file is not read into memory at once, pages are dropped when they are decoded
+    if(!source.open(input, false)) {
+        return FAIL;
+    }
+
+    int width = source.getWidth();
+    int height = source.getHeight();
+    long long capacity = static_cast<long long>(this->band_rows) + this->above + this->below;
+    this->pixels = static_cast<long long>(width) * height;
+    this->window.create(source.getType(), width, int(std::min<long long>(capacity, height)), source.getDepth());
+
+    // window holds rows [low; high) of the file
+    int low = 0;
+    int high = 0;
+    for(int first = 0; first < height; first += this->band_rows) {
+        TRACE_SPAN("Stream::band");
+        int last = std::min(first + this->band_rows, height);
+        int needed_low = std::max(first - this->above, 0);
+        int needed_high = int(std::min<long long>(static_cast<long long>(last) + this->below, height));
+
+        // rows that are still needed are moved to the top of the window, the rest is read
+        if(needed_low > low) {
+            this->window.copyRows(this->window, needed_low - low, 0, high - needed_low);
+            low = needed_low;
+        }
+        if(!this->window.readRows(source, high - low, needed_high - high)) {
+            return discard();
+        }
+        high = needed_high;
+        source.release();
+
+        // band is filtered as a separate image, rows of its halo are only read
+        this->band.create(source.getType(), width, high - low, source.getDepth());
+        this->band.copyRows(this->window, 0, 0, high - low);
+        if(!process(this->band)) {
+            return discard();
+        }
+
+        // type of the output is known when the first band is processed, e.g. after conversion to grey
+        if(first == 0) {
+            opened = file.open(part, this->band.getType(), width, height, this->band.getDepth(), binary);
+            if(!opened) {
+                return FAIL;
+            }
+        }
+        if(!this->band.writeRows(file, first - low, last - first)) {
+            return discard();
+        }
+    }
+
+    if(!file.close()) {
+        return discard();
+    }
+    if(std::rename(part.c_str(), output.c_str()) != 0) {
+        std::cerr << "Error. Could not save an image.\n";
+        return discard();
+    }
+    return SUCCESS;
+}
+
+
+long long Stream::getPixels() const {
+    return this->pixels;
+}
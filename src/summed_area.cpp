@@ -0,0 +1,89 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/summed_area.hh"
+#include "../inc/thread_pool.hh"
+#include "../inc/trace.hh"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+
+SummedArea::SummedArea(int width, int height) : width(width), height(height), stride(std::size_t(width) + 1),
+                                                sums(new std::uint64_t[(std::size_t(height) + 1) * (std::size_t(width) + 1)]) {
+}
+
+
+template <typename T>
+SummedArea SummedArea::build(const T *plane, std::size_t plane_stride, int width, int height) {
+    TRACE_SPAN("SummedArea::build");
+    SummedArea table(width, height);
+    std::uint64_t *sums = table.sums.get();
+    ThreadPool &pool = ThreadPool::instance();
+    std::vector<int> bounds = pool.split(0, height);
+
+    // every band is summed as if it was the whole plane, in one pass over its rows
+    std::memset(sums, 0, table.stride * sizeof(std::uint64_t));
+    pool.run(bounds, [&](int first, int last) {
+        for(int i = first; i < last; ++i) {
+            const T *src = plane + std::size_t(i) * plane_stride;
+            const std::uint64_t *above = sums + std::size_t(i) * table.stride;
+            std::uint64_t *dst = sums + (std::size_t(i) + 1) * table.stride;
+            std::uint64_t sum = 0;
+            dst[0] = 0;
+            for(int j = 0; j < width; ++j) {
+                sum += src[j];
+                dst[j + 1] = (i > first ? above[j + 1] : 0) + sum;
+            }
+        }
+    });
+    if(bounds.size() <= 2) {
+        return table;
+    }
+
+    // then the last row of all bands above is added to every row of a band, the first band is already complete
+    std::vector<std::uint64_t> offsets((bounds.size() - 1) * table.stride, 0);
+    for(std::size_t k = 1; k + 1 < bounds.size(); ++k) {
+        const std::uint64_t *previous = offsets.data() + (k - 1) * table.stride;
+        const std::uint64_t *last = sums + std::size_t(bounds[k]) * table.stride;
+        std::uint64_t *offset = offsets.data() + k * table.stride;
+        for(std::size_t j = 0; j < table.stride; ++j) {
+            offset[j] = previous[j] + last[j];
+        }
+    }
+    pool.run(bounds, [&](int first, int last) {
+        std::size_t band = std::upper_bound(bounds.begin(), bounds.end(), first) - bounds.begin() - 1;
+        const std::uint64_t *offset = offsets.data() + band * table.stride;
+        for(int i = first; i < last && band > 0; ++i) {
+            std::uint64_t *dst = sums + (std::size_t(i) + 1) * table.stride;
+            for(std::size_t j = 0; j < table.stride; ++j) {
+                dst[j] += offset[j];
+            }
+        }
+    });
+    return table;
+}
+
+
+template SummedArea SummedArea::build(const std::uint8_t *plane, std::size_t plane_stride, int width, int height);
+template SummedArea SummedArea::build(const std::uint16_t *plane, std::size_t plane_stride, int width, int height);
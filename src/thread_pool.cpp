@@ -0,0 +1,182 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/thread_pool.hh"
+#include <algorithm>
+
+
+// whether current thread is processing a band, nested jobs are processed sequentially
+static thread_local bool inside_band = false;
+
+
+ThreadPool::ThreadPool(int count) {
+    this->start(count);
+}
+
+
+ThreadPool::~ThreadPool() {
+    this->stop();
+}
+
+
+ThreadPool &ThreadPool::instance() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+
+void ThreadPool::setThreads(int count) {
+    this->stop();
+    this->start(count);
+}
+
+
+int ThreadPool::getThreads() const {
+    return this->threads;
+}
+
+
+void ThreadPool::start(int count) {
+    this->threads = std::max(count, 1);
+    this->stopping = false;
+    for(int t = 1; t < this->threads; ++t) {
+        this->workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for(std::thread &worker : this->workers) {
+        worker.join();
+    }
+    this->workers.clear();
+}
+
+
+std::vector<int> ThreadPool::split(int begin, int end) const {
+    std::vector<int> bounds;
+    int rows = std::max(end - begin, 0);
+    int bands = std::max(std::min(this->threads, rows), 1);
+
+    for(int k = 0; k <= bands; ++k) {
+        bounds.push_back(begin + int(static_cast<long long>(rows) * k / bands));
+    }
+    return bounds;
+}
+
+
+void ThreadPool::run(const std::vector<int> &bounds, const std::function<void(int, int)> &body) {
+    int bands = int(bounds.size()) - 1;
+
+    std::unique_lock<std::mutex> submit(this->submitting, std::defer_lock);
+
+    // nothing to share with workers, or they are busy with a job of another thread
+    if(bands <= 1 || this->workers.empty() || inside_band || !submit.try_lock()) {
+        for(int k = 0; k < bands; ++k) {
+            body(bounds[k], bounds[k+1]);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->job = &body;
+        this->bounds = &bounds;
+        this->next = 0;
+        this->remaining = bands;
+        this->generation++;
+    }
+    this->wake.notify_all();
+
+    // calling thread takes bands as well
+    this->work(body, bounds);
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->done.wait(lock, [this] { return this->remaining == 0 && this->active == 0; });
+    this->job = nullptr;
+    this->bounds = nullptr;
+}
+
+
+ThreadPool::Sequential::Sequential() : previous(inside_band) {
+    inside_band = true;
+}
+
+
+ThreadPool::Sequential::~Sequential() {
+    inside_band = this->previous;
+}
+
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)> &body) {
+    this->run(this->split(begin, end), body);
+}
+
+
+void ThreadPool::work(const std::function<void(int, int)> &body, const std::vector<int> &boundaries) {
+    int bands = int(boundaries.size()) - 1;
+
+    inside_band = true;
+    for(int band = this->next++; band < bands; band = this->next++) {
+        body(boundaries[band], boundaries[band+1]);
+        if(--this->remaining == 0) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->done.notify_all();
+        }
+    }
+    inside_band = false;
+}
+
+
+void ThreadPool::workerLoop() {
+    unsigned long seen = 0;
+
+    while(true) {
+        const std::function<void(int, int)> *body;
+        const std::vector<int> *boundaries;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [&] { return this->stopping || (this->job && this->generation != seen); });
+            if(this->stopping) {
+                return;
+            }
+            seen = this->generation;
+            body = this->job;
+            boundaries = this->bounds;
+            this->active++;
+        }
+
+        this->work(*body, *boundaries);
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->active--;
+        }
+        this->done.notify_all();
+    }
+}
@@ -0,0 +1,159 @@
+/*
+Copyright (c) 2021 Marcin Salamandra
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "../inc/trace.hh"
+
+
+#ifdef TRACING
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+
+// innermost span of every thread
+static thread_local TraceSpan *innermost = nullptr;
+
+
+/**
+ * @brief Small number of current thread, threads are numbered in order in which they record their first span
+ * @return Number of thread
+ */
+static int threadNumber() {
+    static std::atomic<int> threads{0};
+    static thread_local int number = ++threads;
+    return number;
+}
+
+
+Tracer &Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+
+Tracer::~Tracer() {
+    const char *file_name = std::getenv("IMAGE_TRACE");
+
+    this->writeTrace(file_name ? file_name : "trace.json");
+    this->printSummary();
+}
+
+
+std::int64_t Tracer::now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->origin).count();
+}
+
+
+void Tracer::record(const TraceEvent &event) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->events.push_back(event);
+}
+
+
+void Tracer::writeTrace(const std::string &file_name) const {
+    std::ofstream trace(file_name);
+
+    // complete events("ph": "X") with timestamps in microseconds
+    trace << std::fixed << std::setprecision(3) << "{\"traceEvents\": [\n";
+    for(std::size_t k = 0; k < this->events.size(); ++k) {
+        const TraceEvent &event = this->events[k];
+        trace << "  {\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread
+              << ", \"ts\": " << event.start / 1e3 << ", \"dur\": " << event.duration / 1e3
+              << ", \"args\": {\"bytes_read\": " << event.counters[TRACE_BYTES_READ]
+              << ", \"bytes_written\": " << event.counters[TRACE_BYTES_WRITTEN]
+              << ", \"pixels\": " << event.counters[TRACE_PIXELS]
+              << ", \"allocations\": " << event.counters[TRACE_ALLOCATIONS] << "}}"
+              << (k + 1 < this->events.size() ? "," : "") << "\n";
+    }
+    trace << "]}\n";
+    if(!trace.good()) {
+        std::cerr << "Error. Could not write trace to " << file_name << ".\n";
+    }
+}
+
+
+void Tracer::printSummary() const {
+    struct Total {
+        std::uint64_t calls = 0;
+        std::int64_t duration = 0;
+        std::uint64_t counters[TRACE_COUNTERS] = {};
+    };
+    std::map<std::string, Total> totals;
+
+    for(const TraceEvent &event : this->events) {
+        Total &total = totals[event.name];
+        total.calls++;
+        total.duration += event.duration;
+        for(int c = 0; c < TRACE_COUNTERS; ++c) {
+            total.counters[c] += event.counters[c];
+        }
+    }
+
+    // times include nested spans
+    std::cerr << std::left << std::setw(32) << "span" << std::right << std::setw(8) << "calls" << std::setw(14) << "total ms"
+              << std::setw(12) << "mean ms" << std::setw(14) << "read MB" << std::setw(14) << "written MB"
+              << std::setw(12) << "MP" << std::setw(8) << "allocs" << "\n";
+    std::cerr << std::fixed << std::setprecision(3);
+    for(const auto &entry : totals) {
+        const Total &total = entry.second;
+        std::cerr << std::left << std::setw(32) << entry.first << std::right << std::setw(8) << total.calls
+                  << std::setw(14) << total.duration / 1e6 << std::setw(12) << total.duration / 1e6 / total.calls
+                  << std::setw(14) << total.counters[TRACE_BYTES_READ] / 1e6 << std::setw(14) << total.counters[TRACE_BYTES_WRITTEN] / 1e6
+                  << std::setw(12) << total.counters[TRACE_PIXELS] / 1e6 << std::setw(8) << total.counters[TRACE_ALLOCATIONS] << "\n";
+    }
+}
+
+
+TraceSpan::TraceSpan(const char *name) : event{name, Tracer::instance().now(), 0, threadNumber(), {}}, parent(innermost) {
+    innermost = this;
+}
+
+
+TraceSpan::~TraceSpan() {
+    this->event.duration = Tracer::instance().now() - this->event.start;
+    Tracer::instance().record(this->event);
+
+    // counters of nested spans are included in their parents
+    if(this->parent) {
+        for(int c = 0; c < TRACE_COUNTERS; ++c) {
+            this->parent->event.counters[c] += this->event.counters[c];
+        }
+    }
+    innermost = this->parent;
+}
+
+
+void TraceSpan::count(TraceCounter counter, std::uint64_t value) {
+    if(innermost) {
+        innermost->event.counters[counter] += value;
+    }
+}
+
+
+#endif
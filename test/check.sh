@@ -0,0 +1,74 @@
+#!/bin/bash
+# Checks that compare results of the program with each other, run by make check.
+# Usage: test/check.sh [program]
+
+run=${1:-./run}
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+# report a failed check
+fail() {
+    echo "FAILED: $*"
+    failed=1
+}
+
+# options that are not numbers in range of int are rejected
+for arguments in "blur=99999999999" "median=99999999999" "-j 99999999999" "-m 99999999999 negative"; do
+    "$run" -i pic/kubus.pgm -o "$tmp/rejected.pgm" $arguments 2> /dev/null && fail "accepted $arguments"
+done
+
+# images one pixel wide
+printf 'P2\n1 7\n255\n10 200 30 90 250 0 128\n' > "$tmp/narrow.pgm"
+printf 'P3\n1 9\n255\n' > "$tmp/narrow.ppm"
+for i in $(seq 9); do
+    echo "$((i * 25)) $((255 - i * 20)) $((i * 7))" >> "$tmp/narrow.ppm"
+done
+
+# a point filter fused after a neighbourhood filter gives the same result as when it is applied on its own
+for img in narrow.pgm narrow.ppm; do
+    colour=""
+    [ "${img##*.}" = ppm ] && colour="colour=all"
+    for chain in "vblur=2 negative" "blur=2 threshold=0.5" "hblur=1 gamma=2.2" "contour level=0.2" "gauss=1 level=0.2" "median=1 negative"; do
+        filters=($chain)
+        "$run" -i "$tmp/$img" -o "$tmp/fused.${img##*.}" $colour ${filters[0]} ${filters[1]} || fail "$img $chain"
+        "$run" -i "$tmp/$img" -o "$tmp/first.${img##*.}" $colour ${filters[0]} || fail "$img ${filters[0]}"
+        "$run" -i "$tmp/first.${img##*.}" -o "$tmp/second.${img##*.}" $colour ${filters[1]} || fail "$img ${filters[1]}"
+        cmp -s "$tmp/fused.${img##*.}" "$tmp/second.${img##*.}" || fail "fused $img $chain"
+    done
+done
+
+# an image streamed in bands gives the same result as the whole image, for every filter that can be streamed
+for img in pic/kubus.pgm pic/kubus3.ppm; do
+    colour=""
+    [ "${img##*.}" = ppm ] && colour="colour=all"
+    for chain in "negative" "threshold=0.5" "black=0.3" "white=0.7" "gamma=2.2" "level=0.2" "contour" "hblur=3" "vblur=2" "blur=3" \
+                 "hblur=3 vblur=2" "blur=2 contour gamma=0.5" "blur=1073741824 hblur=1073741824 vblur=1073741824" \
+                 "gauss=1.5" "sharpen=1" "kernel=1,2,1,2,4,2,1,2,1" "contour=sobel" "contour=scharr,l2" \
+                 "median=2" "median=1 blur=2 contour gamma=0.5"; do
+        "$run" -i "$img" -o "$tmp/whole.${img##*.}" $colour $chain || fail "$img $chain"
+        for rows in 1 7 50; do
+            "$run" -i "$img" -o "$tmp/streamed.${img##*.}" -m $rows $colour $chain || fail "$img -m $rows $chain"
+            cmp -s "$tmp/whole.${img##*.}" "$tmp/streamed.${img##*.}" || fail "streamed $img -m $rows $chain"
+        done
+    done
+done
+"$run" -i pic/kubus3.ppm -o "$tmp/whole.pgm" grey=709 blur=1 || fail "grey=709 blur=1"
+"$run" -i pic/kubus3.ppm -o "$tmp/streamed.pgm" -m 7 grey=709 blur=1 || fail "-m 7 grey=709 blur=1"
+cmp -s "$tmp/whole.pgm" "$tmp/streamed.pgm" || fail "streamed grey=709 blur=1"
+
+# streamed output may replace its input, in both single file and batch mode
+mkdir "$tmp/in_place"
+cp pic/kubus.pgm pic/kubus3.ppm "$tmp/in_place/"
+"$run" -i pic/kubus3.ppm -o "$tmp/whole.ppm" negative || fail "negative"
+"$run" -i "$tmp/in_place/kubus3.ppm" -o "$tmp/in_place/kubus3.ppm" -m 1 negative || fail "in place -m 1 negative"
+cmp -s "$tmp/whole.ppm" "$tmp/in_place/kubus3.ppm" || fail "streamed in place"
+cp pic/kubus3.ppm "$tmp/in_place/"
+"$run" -b "$tmp/in_place" -o "$tmp/in_place" -m 4 negative > /dev/null || fail "batch in place -m 4 negative"
+cmp -s "$tmp/whole.ppm" "$tmp/in_place/kubus3.ppm" || fail "streamed batch in place"
+[ "$(ls "$tmp/in_place")" = "$(printf 'kubus.pgm\nkubus3.ppm')" ] || fail "files left after streaming in place"
+
+if [ $failed -eq 0 ]; then
+    echo "All checks passed"
+fi
+exit $failed